@@ -0,0 +1,228 @@
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../source/Analyzer.h"
+#include "../source/Compiler.h"
+#include "../source/parser/Lexer.h"
+#include "../source/parser/Parser.h"
+#include "../source/shared/Document.h"
+#include "../source/shared/SharedContext.h"
+#include "generated_source.h"
+
+// Measures throughput of each front-end stage (lexer, parser, analyzer and compiler) separately on generated sources
+// of given total sizes (in megabytes, 1 and 4 by default) and latency of incremental edits of a Document.
+// Results are printed as csv, comparing throughput between sizes shows stages which scale superlinearly.
+
+namespace {
+    constexpr int RUNS = 5;
+
+    double seconds_since(const std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // compiler compiles function bodies only when they are called for the first time, bench forces all of them
+    bool compile_all(SharedContext& context, Function* function) {
+        if (!function->is_compiled() && !context.compile_lazy(function)) {
+            return false;
+        }
+        for (const auto& constant : function->get_constants()) {
+            if (auto object = constant.as<Object*>()) {
+                if (auto* nested = dynamic_cast<Function*>(*object); nested && !compile_all(context, nested)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    struct StageTimes {
+        double lexer = std::numeric_limits<double>::max();
+        double parser = std::numeric_limits<double>::max();
+        double analyzer = std::numeric_limits<double>::max();
+        double compiler = std::numeric_limits<double>::max();
+        double edit = std::numeric_limits<double>::max();
+        std::size_t tokens = 0;
+        std::size_t nodes = 0;
+    };
+
+    bool measure_lexer(const std::filesystem::path& path, double& seconds, std::size_t& tokens) {
+        SharedContext context { bite::Logger(std::cerr, true) };
+        auto start = std::chrono::steady_clock::now();
+        Lexer lexer(bite::source_input_stream(path.string()), &context);
+        while (true) {
+            auto token = lexer.next_token();
+            if (!token) {
+                std::cerr << "lexer error: " << token.error().message << '\n';
+                return false;
+            }
+            if (token->type == Token::Type::END) {
+                break;
+            }
+            ++tokens;
+        }
+        seconds += seconds_since(start);
+        return true;
+    }
+
+    struct FileTimes {
+        double parser = 0;
+        double analyzer = 0;
+        double compiler = 0;
+        std::size_t nodes = 0;
+    };
+
+    bool measure_stages(const std::filesystem::path& path, FileTimes& times) {
+        SharedContext context { bite::Logger(std::cerr, true) };
+
+        auto start = std::chrono::steady_clock::now();
+        Parser parser { bite::source_input_stream(path.string()), &context };
+        Ast ast = parser.parse();
+        times.parser += seconds_since(start);
+        if (parser.has_errors()) {
+            parser.get_diagnostics().print(context.files, context.sources, std::cerr);
+            return false;
+        }
+        times.nodes += ast.arena->allocation_count();
+
+        start = std::chrono::steady_clock::now();
+        bite::Analyzer analyzer { &context };
+        analyzer.analyze(ast);
+        times.analyzer += seconds_since(start);
+        if (analyzer.has_errors()) {
+            context.diagnostics.print(context.files, context.sources, std::cerr);
+            return false;
+        }
+
+        start = std::chrono::steady_clock::now();
+        Compiler compiler { &context };
+        bool is_compiled = compiler.compile(&ast);
+        for (auto* function : compiler.get_functions()) {
+            context.gc.add_object(function);
+        }
+        if (!is_compiled) {
+            for (const auto& error : compiler.get_errors()) {
+                std::cerr << "compiler error: " << error.what() << '\n';
+            }
+            return false;
+        }
+        if (!compile_all(context, compiler.get_main())) {
+            return false;
+        }
+        times.compiler += seconds_since(start);
+        return true;
+    }
+
+    // every stage is measured on all files, best run of each stage is kept
+    bool measure_files(const std::vector<std::filesystem::path>& paths, StageTimes& times) {
+        double lexer = 0;
+        std::size_t tokens = 0;
+        FileTimes file_times;
+        for (const auto& path : paths) {
+            if (!measure_lexer(path, lexer, tokens) || !measure_stages(path, file_times)) {
+                return false;
+            }
+        }
+        times.lexer = std::min(times.lexer, lexer);
+        times.parser = std::min(times.parser, file_times.parser);
+        times.analyzer = std::min(times.analyzer, file_times.analyzer);
+        times.compiler = std::min(times.compiler, file_times.compiler);
+        times.tokens = tokens;
+        times.nodes = file_times.nodes;
+        return true;
+    }
+
+    // types into body of a function in the middle of the document and erases it again
+    bool measure_edits(const std::filesystem::path& path, const std::string& source, StageTimes& times) {
+        SharedContext context { bite::Logger(std::cerr, true) };
+        Document document(&context, path.string(), source);
+        constexpr std::string_view STATEMENT = "let total = 0";
+        constexpr std::string_view INSERTED = " + 1";
+        std::size_t position = source.find(STATEMENT, source.size() / 2) + STATEMENT.size();
+        for (int run = 0; run < RUNS; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            document.edit(position, position, INSERTED);
+            bool was_incremental = document.was_incremental();
+            document.edit(position, position + INSERTED.size(), "");
+            times.edit = std::min(times.edit, seconds_since(start) / 2);
+            if (!was_incremental || !document.was_incremental()) {
+                std::cerr << "edit was not incremental\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void report(
+        const std::string_view stage,
+        const std::size_t bytes,
+        const std::size_t items,
+        const double seconds
+    ) {
+        double megabytes_per_second = static_cast<double>(bytes) / (1024 * 1024) / seconds;
+        std::cout << std::format(
+            "{},{},{},{:.3f},{:.2f},{:.0f}\n",
+            stage,
+            bytes,
+            items,
+            seconds * 1000,
+            megabytes_per_second,
+            static_cast<double>(items) / seconds
+        );
+    }
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::size_t> sizes;
+    for (int i = 1; i < argc; ++i) {
+        sizes.push_back(std::stoul(argv[i]));
+    }
+    if (sizes.empty()) {
+        sizes = { 1, 4 };
+    }
+
+    // items are tokens for lexer and syntax tree nodes for the other stages
+    std::cout << "stage,bytes,items,best_ms,mb_per_s,items_per_s\n";
+    auto directory = std::filesystem::temp_directory_path() / "bite_frontend_bench";
+    std::filesystem::create_directories(directory);
+    for (auto megabytes : sizes) {
+        std::vector<std::string> sources = bench::generate_files(megabytes * 1024 * 1024);
+        std::vector<std::filesystem::path> paths;
+        std::size_t bytes = 0;
+        for (std::size_t i = 0; i < sources.size(); ++i) {
+            paths.push_back(directory / std::format("file{}.bite", i));
+            std::ofstream file(paths.back(), std::ios::binary | std::ios::trunc);
+            file.write(sources[i].data(), static_cast<std::streamsize>(sources[i].size()));
+            bytes += sources[i].size();
+        }
+
+        StageTimes times;
+        for (int run = 0; run < RUNS; ++run) {
+            if (!measure_files(paths, times)) {
+                std::filesystem::remove_all(directory);
+                return 1;
+            }
+        }
+        // document is only analyzed so it can hold all units
+        std::string joined;
+        for (const auto& source : sources) {
+            joined += source;
+        }
+        if (!measure_edits(directory / "joined.bite", joined, times)) {
+            std::filesystem::remove_all(directory);
+            return 1;
+        }
+        report("lexer", bytes, times.tokens, times.lexer);
+        report("parser", bytes, times.nodes, times.parser);
+        report("analyzer", bytes, times.nodes, times.analyzer);
+        report("compiler", bytes, times.nodes, times.compiler);
+        // items are edits
+        report("incremental_edit", bytes, 1, times.edit);
+    }
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,118 @@
+#ifndef GENERATED_SOURCE_H
+#define GENERATED_SOURCE_H
+#include <format>
+#include <string>
+#include <vector>
+
+// Valid bite source of arbitrary size shared by front-end benchmarks.
+
+namespace bench {
+    constexpr int NESTING_DEPTH = 24;
+    // top-level declarations of one unit add about 34 constants to main function of its file and constant indexes
+    // are single byte, so every file holds only a few units
+    constexpr std::size_t UNITS_PER_FILE = 6;
+
+    // Unit exercises class inheritance with traits, long string interpolations, deeply nested blocks, module path
+    // resolution and every lexer scanning loop (comments, escapes, numbers). Every unit references module of the
+    // previous unit in the same file so lookups cross many modules.
+    inline void append_unit(std::string& source, const std::size_t index) {
+        source += std::format(
+            R"(
+trait Shape{0} {{
+    area();
+
+    describe() {{
+        return "shape {0} with area ${{area()}}";
+    }}
+}}
+
+class Base{0} {{
+    x;
+
+    init(x) {{
+        this.x = x;
+    }}
+}}
+
+class Derived{0} : Base{0} using Shape{0} {{
+    y;
+
+    init(x, y) : super(x) {{
+        this.y = y;
+    }}
+
+    area() {{
+        return x * y;
+    }}
+
+    summary(label) {{
+        return "$label: x = ${{x}}, y = ${{y}}, area = ${{this.area()}}, described as ${{this.describe()}}, sum = ${{x + y}}";
+    }}
+}}
+
+module Module{0} {{
+    module inner {{
+        fun value() {{
+            return {0};
+        }}
+    }}
+
+    fun base() {{
+        return inner::value();
+    }}
+}}
+
+# computes some values, this comment is here to exercise comment skipping
+fun compute{0}(v0) {{
+    let escaped = "tab\tand newline\n with unicode \u{{1F600}} and quotes \"inside\"";
+    let ratio = 3.14159;
+    let total = 0;
+)",
+            index
+        );
+        for (int depth = 1; depth <= NESTING_DEPTH; ++depth) {
+            std::string indent(4 * depth, ' ');
+            source += std::format("{0}let v{1} = v{2} + {1};\n{0}if v{1} > {1} {{\n", indent, depth, depth - 1);
+        }
+        source += std::format("{}total = total + v{};\n", std::string(4 * (NESTING_DEPTH + 1), ' '), NESTING_DEPTH);
+        for (int depth = NESTING_DEPTH; depth >= 1; --depth) {
+            source += std::format("{}}}\n", std::string(4 * depth, ' '));
+        }
+        std::string previous = index % UNITS_PER_FILE > 0 ? std::format(" + Module{}::base()", index - 1) : "";
+        source += std::format(
+            R"(    return total + Module{0}::base(){1};
+}}
+
+let instance{0} = Derived{0}({0}, 2);
+)",
+            index,
+            previous
+        );
+    }
+
+    // sources of files which together have at least given size (in bytes)
+    inline std::vector<std::string> generate_files(const std::size_t size) {
+        std::vector<std::string> files;
+        std::size_t total = 0;
+        for (std::size_t index = 0; total < size; ++index) {
+            if (index % UNITS_PER_FILE == 0) {
+                files.emplace_back();
+            }
+            std::size_t before = files.back().size();
+            append_unit(files.back(), index);
+            total += files.back().size() - before;
+        }
+        return files;
+    }
+
+    // all files joined into single source, it can be lexed and parsed but has too many constants to be compiled
+    inline std::string generate_source(const std::size_t size) {
+        std::string source;
+        for (const auto& file : generate_files(size)) {
+            source += file;
+        }
+        return source;
+    }
+} // namespace bench
+
+#endif //GENERATED_SOURCE_H
@@ -0,0 +1,54 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../source/parser/Lexer.h"
+#include "../source/shared/SharedContext.h"
+#include "generated_source.h"
+
+// Measures throughput of Lexer::next_token on generated source of given size (in megabytes, 16 by default).
+
+namespace {
+    constexpr int RUNS = 5;
+} // namespace
+
+int main(int argc, char** argv) {
+    std::size_t megabytes = argc > 1 ? std::stoul(argv[1]) : 16;
+    std::string source = bench::generate_source(megabytes * 1024 * 1024);
+    auto path = std::filesystem::temp_directory_path() / "bite_lexer_bench.bite";
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(source.data(), static_cast<std::streamsize>(source.size()));
+    }
+
+    SharedContext context { bite::Logger(std::cerr, true) };
+    double best_seconds = 0;
+    std::size_t tokens = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        Lexer lexer(bite::source_input_stream(path.string()), &context);
+        tokens = 0;
+        while (true) {
+            auto token = lexer.next_token();
+            if (!token) {
+                std::cerr << "lexer error: " << token.error().message << '\n';
+                return 1;
+            }
+            if (token->type == Token::Type::END) {
+                break;
+            }
+            ++tokens;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (run == 0 || elapsed.count() < best_seconds) {
+            best_seconds = elapsed.count();
+        }
+    }
+    std::filesystem::remove(path);
+
+    double megabytes_per_second = static_cast<double>(source.size()) / (1024 * 1024) / best_seconds;
+    std::cout << "lexed " << source.size() << " bytes, " << tokens << " tokens in " << best_seconds * 1000 << " ms ("
+        << megabytes_per_second << " MB/s, " << static_cast<double>(tokens) / best_seconds << " tokens/s)\n";
+}
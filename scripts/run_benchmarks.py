@@ -0,0 +1,46 @@
+from pathlib import Path
+import subprocess
+import sys
+import time
+
+
+# Compares run time of benchmarks between bite executables, for example builds with and without slot operands:
+# cmake -S . -B build-stack -DBITE_SLOT_OPERANDS=OFF && cmake --build build-stack
+# cmake -S . -B build-slots && cmake --build build-slots
+# python scripts/run_benchmarks.py build-stack/bite build-slots/bite
+
+RUNS = 5
+
+
+def measure(executable_path, benchmark_path):
+    # best of runs is the least noisy estimate
+    best = None
+    output = None
+    for _ in range(RUNS):
+        start = time.perf_counter()
+        result = subprocess.run([executable_path, benchmark_path], check=True, text=True, capture_output=True)
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+        output = result.stdout
+    return best, output
+
+
+if len(sys.argv) < 2:
+    print("Usage: python scripts/run_benchmarks.py [bite executable] [other bite executables to compare]...")
+    sys.exit(1)
+
+executables = sys.argv[1:]
+print("benchmark".ljust(24) + "".join(Path(executable).parent.name.rjust(24) for executable in executables))
+for benchmark_path in sorted(Path("benchmarks").glob("*.bite")):
+    times = []
+    outputs = set()
+    for executable in executables:
+        elapsed, output = measure(executable, benchmark_path)
+        times.append(elapsed)
+        outputs.add(output)
+    row = benchmark_path.stem.ljust(24)
+    for elapsed in times:
+        row += f"{elapsed * 1000:.1f} ms ({times[0] / elapsed:.2f}x)".rjust(24)
+    if len(outputs) > 1:
+        row += "  outputs differ!"
+    print(row)
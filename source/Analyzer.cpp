@@ -35,6 +35,16 @@ void bite::Analyzer::analyze(Ast& ast) {
     }
 }
 
+void bite::Analyzer::reanalyze_function(Ast& ast, FunctionDeclaration& function) {
+    this->ast = &ast;
+    m_globals_hoisted = true;
+    BITE_ASSERT(ast.enviroment.globals.contains(function.name.string));
+    // same as hoisting, function_declaration then marks it as defined
+    function.info = GlobalDeclarationInfo { .declaration = &function, .name = function.name.string };
+    ast.enviroment.globals[function.name.string] = { &function, false };
+    visit(function);
+}
+
 void bite::Analyzer::block_expr(BlockExpr& expr) {
     // investigate performance
     with_context(
@@ -509,6 +519,9 @@ void bite::Analyzer::binary_expr(BinaryExpr& expr) {
 }
 
 void bite::Analyzer::call_expr(CallExpr& expr) {
+    if (expr.callee->is_anonymous_function_expr()) {
+        expr.callee->as_anonymous_function_expr()->function->is_immediately_invoked = true;
+    }
     visit(*expr.callee);
     for (auto& argument : expr.arguments) {
         visit(*argument);
@@ -679,7 +692,7 @@ void bite::Analyzer::import_stmt(ImportStmt& stmt) {
         }
     } else if (stmt.module->is_string_expr()) {
         //TODO: string node should contain interned string
-        auto* module = context->get_module(context->intern(stmt.module->as_string_expr()->string));
+        auto* module = context->get_module(context->intern(stmt.module->as_string_expr()->string), true);
 
         // TODO: refactor!
         if (!module) {
@@ -1416,6 +1429,10 @@ Binding bite::Analyzer::propagate_upvalues(
             is_local = false;
         }
     }
+    // only the innermost function uses the upvalue, others just pass it further
+    for (auto* enviroment : enviroments_visited | std::views::drop(1)) {
+        enviroment->relays_upvalues = true;
+    }
     return UpvalueBinding { .idx = value, .info = binding.info };
 }
 
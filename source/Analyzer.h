@@ -59,6 +59,9 @@ namespace bite {
         void declare(Declaration* declaration);
 
         void analyze(Ast& ast);
+        // Analyzes top-level function which replaced declaration of the same name in already analyzed ast.
+        // Other statements keep bindings to the replaced declaration so it must stay alive.
+        void reanalyze_function(Ast& ast, FunctionDeclaration& function);
         void block_expr(BlockExpr& expr);
         void variable_declaration(VariableDeclaration& stmt);
         void variable_expr(VariableExpr& expr);
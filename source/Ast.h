@@ -8,6 +8,7 @@
 #include "core_module.h"
 #include "Diagnostics.h"
 #include "Value.h"
+#include "base/arena.h"
 #include "base/bitflags.h"
 #include "base/box.h"
 #include "parser/Token.h"
@@ -79,6 +80,8 @@ enum class NodeKind : std::uint8_t {
 AST_NODES(DECLARE_NODE)
 
 class AstNode {
+    static constexpr std::size_t NODE_HEADER_SIZE = alignof(std::max_align_t);
+
 public:
     [[nodiscard]] virtual NodeKind kind() const = 0;
     virtual ~AstNode() = default;
@@ -89,6 +92,23 @@ public:
 
     AST_NODES(TYPE_METHODS)
 
+    // Nodes are placed in the current arena (set by parser to arena of ast being parsed) so they are freed together
+    // with their ast. Every node is prefixed with its arena to know if it has to be freed on its own.
+    static void* operator new(const std::size_t size) {
+        bite::Arena* arena = bite::Arena::current();
+        void* memory = arena ? arena->allocate(NODE_HEADER_SIZE + size, NODE_HEADER_SIZE)
+                             : ::operator new(NODE_HEADER_SIZE + size);
+        *static_cast<bite::Arena**>(memory) = arena;
+        return static_cast<std::byte*>(memory) + NODE_HEADER_SIZE;
+    }
+
+    static void operator delete(void* node) {
+        void* memory = static_cast<std::byte*>(node) - NODE_HEADER_SIZE;
+        if (*static_cast<bite::Arena**>(memory) == nullptr) {
+            ::operator delete(memory);
+        }
+    }
+
     bite::SourceSpan span;
     explicit AstNode(const bite::SourceSpan& span) : span(span) {}
 };
@@ -183,6 +203,8 @@ struct FunctionEnviroment {
     Locals locals;
     std::vector<UpValue> upvalues;
     std::vector<std::pair<StringTable::Handle, bite::SourceSpan>> parameters;
+    // nested functions capture variables of enclosing functions thru upvalues of this function
+    bool relays_upvalues = false;
 };
 
 
@@ -236,6 +258,8 @@ public:
 
 class Ast {
 public:
+    // owns memory of all nodes so it must outlive them
+    std::unique_ptr<bite::Arena> arena;
     std::vector<std::unique_ptr<Stmt>> stmts;
     GlobalEnviroment enviroment;
 };
@@ -583,6 +607,8 @@ public:
     std::vector<FunctionParameter> params;
     std::unique_ptr<Expr> body;
     FunctionEnviroment enviroment {};
+    // anonymous function called right where it is created e.g. (|x| { ... })(1), its closure can't escape
+    bool is_immediately_invoked = false;
 
     FunctionDeclaration(
         const bite::SourceSpan& span,
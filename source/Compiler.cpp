@@ -1,6 +1,8 @@
 #include "Compiler.h"
 
 #include <cassert>
+#include <format>
+#include <limits>
 #include <ranges>
 
 #include "Analyzer.h"
@@ -10,8 +12,22 @@
 
 //#define COMPILER_PRINT_BYTECODE
 
+namespace {
+    // Pending forward jump is redirected through a jump island once its target could get out of range of 16-bit
+    // offset. Other half of the range is left for the instruction emitted before the island and the island itself.
+    constexpr std::size_t ISLAND_DISTANCE = std::numeric_limits<std::int16_t>::max() / 2;
+
+    bool fits_short_jump(const std::size_t position, const std::size_t destination) {
+        auto offset = static_cast<std::int64_t>(destination) - static_cast<std::int64_t>(position + 2);
+        return std::numeric_limits<std::int16_t>::min() <= offset && offset <= std::numeric_limits<std::int16_t>::max();
+    }
+} // namespace
+
 bool Compiler::compile(Ast* ast) {
     this->ast = ast;
+    main = new Function("main", 0, 0);
+    context_stack.emplace_back(main, FunctionType::FUNCTION);
+    functions.push_back(main);
     for (auto& stmt : ast->stmts) {
         visit(*stmt);
     }
@@ -23,6 +39,31 @@ bool Compiler::compile(Ast* ast) {
     Disassembler disassembler(*current_function());
     disassembler.disassemble(current_function()->to_string());
     #endif
+    // main context is never ended
+    main->set_max_stack(static_cast<int>(current_context().on_stack.max));
+    check_constants(main);
+    return errors.empty();
+}
+
+bool Compiler::compile_lazy(Function* function) {
+    const FunctionDeclaration* declaration = function->get_lazy_declaration();
+    BITE_ASSERT(declaration != nullptr);
+    function->set_lazy_declaration(nullptr);
+    // only constructors need special return handling and those are always compiled eagerly
+    with_context(
+        function,
+        FunctionType::FUNCTION,
+        [declaration, this] {
+            function_body(*declaration);
+        }
+    );
+    if (!errors.empty()) {
+        // stays lazy so broken code is never run, serialized or left without its declaration
+        function->get_program() = Program {};
+        function->get_constants().clear();
+        function->set_lazy_declaration(declaration);
+        return false;
+    }
     return true;
 }
 
@@ -34,10 +75,15 @@ const std::vector<Function*>& Compiler::get_functions() {
     return functions;
 }
 
+const std::vector<Compiler::Error>& Compiler::get_errors() const {
+    return errors;
+}
+
 
 void Compiler::this_expr(const ThisExpr&) {
     // safety: check if used in class method context
     emit(OpCode::THIS);
+    current_context().on_stack++;
 }
 
 void Compiler::start_context(Function* function, FunctionType type) {
@@ -52,9 +98,27 @@ void Compiler::end_context() {
     disassembler.disassemble(current_function()->to_string());
     #endif
 
+    current_function()->set_max_stack(static_cast<int>(current_context().on_stack.max));
+    check_constants(current_function());
     context_stack.pop_back();
 }
 
+// constant indexes are encoded in single byte operand so further constants would silently alias the first ones
+void Compiler::check_constants(Function* function) {
+    constexpr std::size_t MAX_CONSTANTS = std::numeric_limits<bite_byte>::max() + 1;
+    std::size_t count = function->get_constants().size();
+    if (count > MAX_CONSTANTS) {
+        errors.emplace_back(
+            std::format(
+                "function \"{}\" needs {} constants but at most {} can be addressed",
+                function->get_name(),
+                count,
+                MAX_CONSTANTS
+            )
+        );
+    }
+}
+
 Compiler::Context& Compiler::current_context() {
     return context_stack.back();
 }
@@ -73,6 +137,9 @@ void Compiler::emit(bite_byte byte) {
 }
 
 void Compiler::emit(OpCode op_code) {
+    if (current_program().size() >= current_context().next_island_check) {
+        emit_jump_island();
+    }
     current_function()->get_program().write(op_code);
 }
 
@@ -81,6 +148,122 @@ void Compiler::emit(OpCode op_code, bite_byte value) {
     emit(value);
 }
 
+int Compiler::new_label() {
+    current_context().labels.emplace_back();
+    return current_context().labels.size() - 1;
+}
+
+void Compiler::bind_label(const int label) {
+    auto& target = current_context().labels[label];
+    target.destination = current_program().size();
+    for (std::size_t position : target.pending_jumps) {
+        patch_jump(position, *target.destination);
+    }
+    for (std::size_t position : target.pending_long_jumps) {
+        patch_long_jump(position, *target.destination);
+    }
+    target.pending_jumps.clear();
+    target.pending_long_jumps.clear();
+}
+
+void Compiler::emit_jump(OpCode op_code, const int label) {
+    emit(op_code);
+    std::size_t position = current_program().size();
+    emit(0);
+    emit(0);
+    auto& target = current_context().labels[label];
+    if (!target.destination) {
+        target.pending_jumps.push_back(position);
+        auto& next_island_check = current_context().next_island_check;
+        next_island_check = std::min(next_island_check, position + 2 + ISLAND_DISTANCE);
+        return;
+    }
+    if (fits_short_jump(position, *target.destination)) {
+        patch_jump(position, *target.destination);
+        return;
+    }
+    // backward jump out of range of 16-bit offset, instructions are written directly so no island gets in between
+    if (op_code == OpCode::JUMP) {
+        current_program().patch(position - 1, static_cast<bite_byte>(OpCode::JUMP_LONG));
+        emit(0);
+        emit(0);
+        patch_long_jump(position, *target.destination);
+        return;
+    }
+    // condition jumps to the long jump, otherwise it is skipped
+    patch_jump(position, position + 2 + 3);
+    current_program().write(OpCode::JUMP);
+    std::size_t skip_position = current_program().size();
+    emit(0);
+    emit(0);
+    patch_jump(skip_position, skip_position + 2 + 5);
+    current_program().write(OpCode::JUMP_LONG);
+    std::size_t long_position = current_program().size();
+    for (int i = 0; i < 4; ++i) {
+        emit(0);
+    }
+    patch_long_jump(long_position, *target.destination);
+}
+
+// Overdue forward jumps are patched to long jumps placed here, which are patched once their labels are bound.
+// Execution skips over the island.
+void Compiler::emit_jump_island() {
+    auto& context = current_context();
+    std::size_t size = current_program().size();
+    std::vector<std::pair<Label*, std::size_t>> overdue;
+    context.next_island_check = SIZE_MAX;
+    for (auto& label : context.labels) {
+        std::erase_if(
+            label.pending_jumps,
+            [&](const std::size_t position) {
+                if (position + 2 + ISLAND_DISTANCE <= size) {
+                    overdue.emplace_back(&label, position);
+                    return true;
+                }
+                context.next_island_check = std::min(context.next_island_check, position + 2 + ISLAND_DISTANCE);
+                return false;
+            }
+        );
+    }
+    if (overdue.empty()) {
+        return;
+    }
+    current_program().write(OpCode::JUMP);
+    std::size_t skip_position = current_program().size();
+    emit(0);
+    emit(0);
+    for (auto [label, position] : overdue) {
+        patch_jump(position, current_program().size());
+        current_program().write(OpCode::JUMP_LONG);
+        label->pending_long_jumps.push_back(current_program().size());
+        for (int i = 0; i < 4; ++i) {
+            emit(0);
+        }
+    }
+    patch_jump(skip_position, current_program().size());
+}
+
+// offset is signed, big endian and relative to the end of jump instruction
+void Compiler::patch_jump(const std::size_t position, const std::size_t destination) {
+    // jumps which could get out of range are redirected through jump islands
+    BITE_ASSERT(fits_short_jump(position, destination));
+    auto offset = static_cast<std::int64_t>(destination) - static_cast<std::int64_t>(position + 2);
+    auto encoded = static_cast<std::uint16_t>(static_cast<std::int16_t>(offset));
+    current_program().patch(position, encoded >> 8);
+    current_program().patch(position + 1, encoded & 0xff);
+}
+
+void Compiler::patch_long_jump(const std::size_t position, const std::size_t destination) {
+    auto offset = static_cast<std::int64_t>(destination) - static_cast<std::int64_t>(position + 4);
+    BITE_ASSERT(
+        std::numeric_limits<std::int32_t>::min() <= offset && offset <= std::numeric_limits<std::int32_t>::max()
+    );
+    auto encoded = static_cast<std::uint32_t>(static_cast<std::int32_t>(offset));
+    for (int i = 0; i < 4; ++i) {
+        current_program().patch(position + i, encoded >> (24 - 8 * i) & 0xff);
+    }
+}
+
 void Compiler::emit_default_return() {
     if (current_context().function_type == FunctionType::CONSTRUCTOR) {
         emit(OpCode::THIS);
@@ -142,12 +325,14 @@ void Compiler::string_interpolation_expr(const StringInterpolationExpr& expr) {
         current_context().on_stack--;
         auto final_idx = current_function()->add_constant(*expr.string_parts[i + 1].string);
         emit(OpCode::CONSTANT, final_idx);
+        current_context().on_stack++;
         emit(OpCode::ADD);
+        current_context().on_stack--;
     }
 }
 
 void Compiler::block_expr(const BlockExpr& expr) {
-    int break_idx = current_function()->add_empty_jump_destination();
+    int break_idx = new_label();
     ExpressionScope scope {
             expr.label
                 ? ExpressionScope(LabeledBlockScope { .label = expr.label->string, .break_idx = break_idx })
@@ -167,18 +352,18 @@ void Compiler::block_expr(const BlockExpr& expr) {
             }
         }
     );
-    current_function()->patch_jump_destination(break_idx, current_program().size());
+    bind_label(break_idx);
 }
 
 void Compiler::loop_expr(const LoopExpr& expr) {
     std::optional<StringTable::Handle> label = expr.label ? expr.label->string : std::optional<StringTable::Handle> {};
-    int continue_idx = current_function()->add_empty_jump_destination();
-    int break_idx = current_function()->add_empty_jump_destination();
+    int continue_idx = new_label();
+    int break_idx = new_label();
 
     with_expression_scope(
         LoopScope { .label = label, .break_idx = break_idx, .continue_idx = continue_idx },
         [&expr, this, continue_idx](const ExpressionScope&) {
-            current_function()->patch_jump_destination(continue_idx, current_program().size());
+            bind_label(continue_idx);
             // TODO: remove this expression?
             with_expression_scope(
                 BlockScope(),
@@ -193,8 +378,8 @@ void Compiler::loop_expr(const LoopExpr& expr) {
             );
         }
     );
-    emit(OpCode::JUMP, continue_idx);
-    current_function()->patch_jump_destination(break_idx, current_program().size());;
+    emit_jump(OpCode::JUMP, continue_idx);
+    bind_label(break_idx);
 }
 
 void Compiler::pop_out_of_scopes(int64_t depth) {
@@ -231,18 +416,17 @@ void Compiler::while_expr(const WhileExpr& expr) {
     // );
     // loop_expression(desugared_while);
     std::optional<StringTable::Handle> label = expr.label ? expr.label->string : std::optional<StringTable::Handle> {};
-    int continue_idx = current_function()->add_empty_jump_destination();
-    int break_idx = current_function()->add_empty_jump_destination();
-    int end_idx = current_function()->add_empty_jump_destination();
+    int continue_idx = new_label();
+    int break_idx = new_label();
+    int end_idx = new_label();
     with_expression_scope(
         LoopScope { .label = label, .break_idx = break_idx, .continue_idx = continue_idx },
         [&expr, this, continue_idx, end_idx](const ExpressionScope&) {
-            current_function()->patch_jump_destination(continue_idx, current_program().size());
+            bind_label(continue_idx);
 
             visit(*expr.condition);
-            emit(OpCode::JUMP_IF_FALSE, end_idx);
-            // pop condition evaluation
-            emit(OpCode::POP);
+            // pops condition evaluation on both paths
+            emit_jump(OpCode::POP_JUMP_IF_FALSE, end_idx);
             current_context().on_stack--;
 
             // TODO: remove this expression?
@@ -259,10 +443,9 @@ void Compiler::while_expr(const WhileExpr& expr) {
             );
         }
     );
-    emit(OpCode::JUMP, continue_idx);
-    current_function()->patch_jump_destination(end_idx, current_program().size());
-    emit(OpCode::POP); // pop evalutaion condition result
-    current_function()->patch_jump_destination(break_idx, current_program().size());
+    emit_jump(OpCode::JUMP, continue_idx);
+    bind_label(end_idx);
+    bind_label(break_idx);
 }
 
 void Compiler::for_expr(const ForExpr& expr) {
@@ -278,22 +461,24 @@ void Compiler::for_expr(const ForExpr& expr) {
             std::optional<StringTable::Handle> label = expr.label
                                                            ? expr.label->string
                                                            : std::optional<StringTable::Handle>();
-            int continue_idx = current_function()->add_empty_jump_destination();
-            int break_idx = current_function()->add_empty_jump_destination();
-            int end_idx = current_function()->add_empty_jump_destination();
+            int continue_idx = new_label();
+            int break_idx = new_label();
+            int end_idx = new_label();
             with_expression_scope(
                 LoopScope { .label = label, .break_idx = break_idx, .continue_idx = continue_idx },
                 [this, continue_idx, &expr, end_idx, iterator_slot](const ExpressionScope&) {
-                    current_function()->patch_jump_destination(continue_idx, current_program().size());
+                    bind_label(continue_idx);
                     // begin condition
                     emit(OpCode::GET, iterator_slot);
+                    current_context().on_stack++;
                     int condition_constant = current_function()->add_constant("has_next");
                     emit(OpCode::GET_PROPERTY, condition_constant);
                     emit(OpCode::CALL, 0);
                     // end condition
 
-                    emit(OpCode::JUMP_IF_FALSE, end_idx);
-                    emit(OpCode::POP); // pop evaluation condition result
+                    // pops evaluation condition result on both paths
+                    emit_jump(OpCode::POP_JUMP_IF_FALSE, end_idx);
+                    current_context().on_stack--;
 
                     // begin item
                     emit(OpCode::GET, iterator_slot);
@@ -317,10 +502,9 @@ void Compiler::for_expr(const ForExpr& expr) {
                     );
                 }
             );
-            emit(OpCode::JUMP, continue_idx);
-            current_function()->patch_jump_destination(end_idx, current_program().size());
-            emit(OpCode::POP); // pop evalutaion condition result
-            current_function()->patch_jump_destination(break_idx, current_program().size());
+            emit_jump(OpCode::JUMP, continue_idx);
+            bind_label(end_idx);
+            bind_label(break_idx);
             emit(OpCode::SET, get_return_slot(scope));
         }
     );
@@ -354,7 +538,7 @@ void Compiler::break_expr(const BreakExpr& expr) {
     pop_out_of_scopes(pop_out_depth + 1);
     // refactor?
     // assert current scope has break idx!
-    emit(
+    emit_jump(
         OpCode::JUMP,
         std::holds_alternative<LoopScope>(scope)
             ? std::get<LoopScope>(scope).break_idx
@@ -383,7 +567,7 @@ void Compiler::continue_expr(const ContinueExpr& expr) {
     pop_out_of_scopes(pop_out_depth + 1);
     // refactor?
     // assert current scope has continue idx!
-    emit(OpCode::JUMP, std::get<LoopScope>(scope).continue_idx);
+    emit_jump(OpCode::JUMP, std::get<LoopScope>(scope).continue_idx);
 }
 
 
@@ -400,33 +584,22 @@ void Compiler::function(const FunctionDeclaration& stmt, FunctionType type) {
 
     auto* function = new Function(function_name, min_arity, stmt.params.size());
     functions.push_back(function);
-
-    with_context(
-        function,
-        type,
-        [&stmt, this] {
-            for (const auto& param : stmt.params) {
-                // TODO: optimize!
-                if (param.default_value) {
-                    auto jump_idx = current_function()->add_empty_jump_destination();
-                    emit_get_variable(param.binding);
-                    emit(OpCode::JUMP_IF_NOT_UNDEFINED, jump_idx);
-                    emit(OpCode::POP);
-                    visit(*param.default_value);
-                    emit_set_variable(param.binding);
-                    emit(OpCode::POP);
-                    auto jump_to_end = current_function()->add_empty_jump_destination();
-                    emit(OpCode::JUMP, jump_to_end);
-                    current_function()->patch_jump_destination(jump_idx, current_program().size());
-                    emit(OpCode::POP);
-                    current_function()->patch_jump_destination(jump_to_end, current_program().size());
-                }
+    auto enclosing_slots = type == FunctionType::FUNCTION ? enclosing_frame_slots(stmt) : std::nullopt;
+    if (enclosing_slots) {
+        // slots of enclosing frame are known only now so body can't be compiled lazily
+        with_context(
+            function,
+            type,
+            [&stmt, &enclosing_slots, this] {
+                current_context().enclosing_slots = std::move(enclosing_slots);
+                function_body(stmt);
             }
-            current_function()->set_upvalue_count(stmt.enviroment.upvalues.size());
-            visit(*stmt.body); // TODO: assert has body?
-            emit_default_return();
-        }
-    );
+        );
+    } else {
+        function->set_upvalue_count(stmt.enviroment.upvalues.size());
+        // body is compiled on the first call as most of functions in imported modules are never called
+        function->set_lazy_declaration(&stmt);
+    }
 
     int constant = current_function()->add_constant(function);
     if (type == FunctionType::METHOD) {
@@ -434,6 +607,9 @@ void Compiler::function(const FunctionDeclaration& stmt, FunctionType type) {
     } else {
         emit(OpCode::CLOSURE, constant);
     }
+    if (function->get_upvalue_count() == 0) {
+        return;
+    }
     for (const UpValue& upvalue : stmt.enviroment.upvalues) {
         emit(upvalue.local);
         if (upvalue.local) {
@@ -444,6 +620,51 @@ void Compiler::function(const FunctionDeclaration& stmt, FunctionType type) {
     }
 }
 
+// Immediately invoked function always runs in the frame right above the frame that created it,
+// so instead of capturing upvalues it can access variables in the enclosing frame directly.
+std::optional<std::vector<bite_byte>> Compiler::enclosing_frame_slots(const FunctionDeclaration& stmt) {
+    if (!stmt.is_immediately_invoked || stmt.enviroment.relays_upvalues) {
+        return {};
+    }
+    std::vector<bite_byte> slots;
+    for (const UpValue& upvalue : stmt.enviroment.upvalues) {
+        if (!upvalue.local) {
+            return {};
+        }
+        auto slot = current_context().slots.find(upvalue.idx);
+        if (slot == current_context().slots.end()) {
+            return {};
+        }
+        slots.push_back(static_cast<bite_byte>(slot->second.index));
+    }
+    return slots;
+}
+
+void Compiler::function_body(const FunctionDeclaration& stmt) {
+    for (const auto& param : stmt.params) {
+        // TODO: optimize!
+        if (param.default_value) {
+            auto jump_idx = new_label();
+            emit_get_variable(param.binding);
+            current_context().on_stack++;
+            emit_jump(OpCode::JUMP_IF_NOT_UNDEFINED, jump_idx);
+            emit(OpCode::POP);
+            current_context().on_stack--;
+            visit(*param.default_value);
+            emit_set_variable(param.binding);
+            emit(OpCode::POP);
+            current_context().on_stack--;
+            auto jump_to_end = new_label();
+            emit_jump(OpCode::JUMP, jump_to_end);
+            bind_label(jump_idx);
+            emit(OpCode::POP);
+            bind_label(jump_to_end);
+        }
+    }
+    visit(*stmt.body); // TODO: assert has body?
+    emit_default_return();
+}
+
 void Compiler::constructor(const Constructor& stmt, const std::vector<Field>& fields, bool has_superclass) {
     // refactor: tons of overlap with function generator
     int min_arity = 0;
@@ -470,18 +691,21 @@ void Compiler::constructor(const Constructor& stmt, const std::vector<Field>& fi
                 for (const auto& param : stmt.function->params) {
                     // TODO: optimize!
                     if (param.default_value) {
-                        auto jump_idx = current_function()->add_empty_jump_destination();
+                        auto jump_idx = new_label();
                         emit_get_variable(param.binding);
-                        emit(OpCode::JUMP_IF_NOT_UNDEFINED, jump_idx);
+                        current_context().on_stack++;
+                        emit_jump(OpCode::JUMP_IF_NOT_UNDEFINED, jump_idx);
                         emit(OpCode::POP);
+                        current_context().on_stack--;
                         visit(*param.default_value);
                         emit_set_variable(param.binding);
                         emit(OpCode::POP);
-                        auto jump_to_end = current_function()->add_empty_jump_destination();
-                        emit(OpCode::JUMP, jump_to_end);
-                        current_function()->patch_jump_destination(jump_idx, current_program().size());
+                        current_context().on_stack--;
+                        auto jump_to_end = new_label();
+                        emit_jump(OpCode::JUMP, jump_to_end);
+                        bind_label(jump_idx);
                         emit(OpCode::POP);
-                        current_function()->patch_jump_destination(jump_to_end, current_program().size());
+                        bind_label(jump_to_end);
                     }
                 }
             }
@@ -493,11 +717,16 @@ void Compiler::constructor(const Constructor& stmt, const std::vector<Field>& fi
                 }
                 // maybe better way to do this instead of this superinstruction?
                 emit(OpCode::CALL_SUPER_CONSTRUCTOR, stmt.super_arguments_call->arguments.size());
+                current_context().on_stack -= stmt.super_arguments_call->arguments.size();
+                current_context().on_stack++;
                 emit(OpCode::POP); // discard constructor response
+                current_context().on_stack--;
             } else if (has_superclass && stmt.super_arguments_call->arguments.empty()) {
                 // default superclass construct
                 emit(OpCode::CALL_SUPER_CONSTRUCTOR, 0);
+                current_context().on_stack++;
                 emit(OpCode::POP); // discard constructor response
+                current_context().on_stack--;
             }
 
             // default initialize
@@ -508,9 +737,12 @@ void Compiler::constructor(const Constructor& stmt, const std::vector<Field>& fi
                 }
                 visit(*field.variable->value);
                 emit(OpCode::THIS);
+                current_context().on_stack++;
                 int property_name = current_function()->add_constant(*field.variable->name.string);
                 emit(OpCode::SET_PROPERTY, property_name);
+                current_context().on_stack--;
                 emit(OpCode::POP); // pop value;
+                current_context().on_stack--;
             }
             if (stmt.function) {
                 if (stmt.function->body) {
@@ -550,25 +782,30 @@ void Compiler::trait_declaration(const TraitDeclaration& stmt) {
     std::string name = *stmt.name.string;
     uint8_t name_constanst = current_function()->add_constant(name);
     emit(OpCode::TRAIT, name_constanst);
+    current_context().on_stack++;
 
     for (const auto& trait_used : stmt.using_stmts) {
         for (const auto& [original_name, field_name, attr] : trait_used.declarations) {
             int field_name_constant = current_function()->add_constant(*original_name);
             emit_get_variable(trait_used.binding);
+            current_context().on_stack++;
             emit(OpCode::GET_TRAIT, field_name_constant);
             emit(0); // TODO HACK
             int aliased_name_constant = current_function()->add_constant(*field_name);
             emit(OpCode::TRAIT_METHOD, aliased_name_constant);
             emit(attr.to_ullong());
+            current_context().on_stack--;
         }
     }
 
     for (const auto& method : stmt.methods) {
         if (!stmt.enviroment.requirements.contains(method.function->name.string)) {
             function(*method.function, FunctionType::METHOD);
+            current_context().on_stack++;
             int method_name_constant = current_function()->add_constant(*method.function->name.string);
             emit(OpCode::TRAIT_METHOD, method_name_constant);
             emit(method.attributes.to_ullong()); // check!
+            current_context().on_stack--;
         }
     }
 
@@ -600,7 +837,9 @@ void Compiler::class_object(const std::string& name, bool is_abstract, const Cla
 
     if (object.superclass) {
         emit_get_variable(object.superclass_binding);
+        current_context().on_stack++;
         emit(OpCode::INHERIT);
+        current_context().on_stack--;
     }
 
     // TODO: overlap with trait declaration
@@ -612,6 +851,7 @@ void Compiler::class_object(const std::string& name, bool is_abstract, const Cla
             // TODO: refactor
             if (attr[ClassAttributes::GETTER]) {
                 emit_get_variable(trait_used.binding);
+                current_context().on_stack++;
                 emit(OpCode::GET_TRAIT, field_name_constant);
                 bitflags<ClassAttributes> hack;
                 hack += ClassAttributes::GETTER;
@@ -619,9 +859,11 @@ void Compiler::class_object(const std::string& name, bool is_abstract, const Cla
                 int aliased_name_constant = current_function()->add_constant(*field_name);
                 emit(OpCode::METHOD, aliased_name_constant);
                 emit(hack.to_ullong());
+                current_context().on_stack--;
             }
             if (attr[ClassAttributes::SETTER]) {
                 emit_get_variable(trait_used.binding);
+                current_context().on_stack++;
                 emit(OpCode::GET_TRAIT, field_name_constant);
                 bitflags<ClassAttributes> hack;
                 hack += ClassAttributes::SETTER;
@@ -629,14 +871,17 @@ void Compiler::class_object(const std::string& name, bool is_abstract, const Cla
                 int aliased_name_constant = current_function()->add_constant(*field_name);
                 emit(OpCode::METHOD, aliased_name_constant);
                 emit(hack.to_ullong());
+                current_context().on_stack--;
             }
             if (!attr[ClassAttributes::GETTER] && !attr[ClassAttributes::SETTER]) {
                 emit_get_variable(trait_used.binding);
+                current_context().on_stack++;
                 emit(OpCode::GET_TRAIT, field_name_constant);
                 emit(0);
                 int aliased_name_constant = current_function()->add_constant(*field_name);
                 emit(OpCode::METHOD, aliased_name_constant);
                 emit(attr.to_ullong());
+                current_context().on_stack--;
             }
         }
     }
@@ -652,14 +897,20 @@ void Compiler::class_object(const std::string& name, bool is_abstract, const Cla
         std::string method_name = *method.function->name.string;
         if (!method.attributes[ClassAttributes::ABSTRACT]) {
             function(*method.function, FunctionType::METHOD);
+            current_context().on_stack++;
         }
         int idx = current_function()->add_constant(method_name);
         emit(OpCode::METHOD, idx);
         emit(method.attributes.to_ullong()); // check size?
+        if (!method.attributes[ClassAttributes::ABSTRACT]) {
+            current_context().on_stack--;
+        }
     }
 
     constructor(object.constructor, object.fields, static_cast<bool>(object.superclass));
+    current_context().on_stack++;
     emit(OpCode::CONSTRUCTOR);
+    current_context().on_stack--;
 }
 
 void Compiler::class_declaration(const ClassDeclaration& stmt) {
@@ -674,6 +925,24 @@ void Compiler::expr_stmt(const ExprStmt& stmt) {
 }
 
 void Compiler::return_expr(const ReturnExpr& stmt) {
+    // constructors must return constructed instance so they can't hand over their frame,
+    // immediately invoked functions need the current frame to access its variables
+    if (stmt.value && stmt.value->is_call_expr() && current_context().function_type != FunctionType::CONSTRUCTOR
+        && !static_cast<const CallExpr&>(*stmt.value).callee->is_anonymous_function_expr()) {
+        const auto& call = static_cast<const CallExpr&>(*stmt.value);
+        visit(*call.callee);
+        for (auto& argument : call.arguments) {
+            visit(*argument);
+        }
+        auto arguments_size = std::ranges::distance(call.arguments);
+        emit(OpCode::TAIL_CALL, arguments_size);
+        // callee and arguments are handed over to the next frame
+        current_context().on_stack -= arguments_size + 1;
+        // Expression must return value
+        emit(OpCode::NIL);
+        current_context().on_stack++;
+        return;
+    }
     if (stmt.value) {
         visit(*stmt.value);
     } else {
@@ -681,6 +950,7 @@ void Compiler::return_expr(const ReturnExpr& stmt) {
         current_context().on_stack++;
     }
     emit(OpCode::RETURN);
+    current_context().on_stack--;
     // Expression must return value
     emit(OpCode::NIL);
     current_context().on_stack++;
@@ -689,23 +959,22 @@ void Compiler::return_expr(const ReturnExpr& stmt) {
 void Compiler::if_expr(const IfExpr& stmt) {
     visit(*stmt.condition);
     // TODO: better control flow constructs this is kinda confusing
-    int jump_to_else = current_function()->add_empty_jump_destination();
-    emit(OpCode::JUMP_IF_FALSE, jump_to_else);
+    int jump_to_else = new_label();
+    // condition is popped on both paths
+    emit_jump(OpCode::POP_JUMP_IF_FALSE, jump_to_else);
     // maybe combine these into utility some bytecode writer which tracks stack
-    emit(OpCode::POP);
     current_context().on_stack--;
     visit(*stmt.then_expr);
-    auto jump_to_end = current_function()->add_empty_jump_destination();
-    emit(OpCode::JUMP, jump_to_end);
-    current_function()->patch_jump_destination(jump_to_else, current_program().size());
-    emit(OpCode::POP); // confusing thing is we don't need to pop this off our stack counter (proof left as a exercise)
+    auto jump_to_end = new_label();
+    emit_jump(OpCode::JUMP, jump_to_end);
+    bind_label(jump_to_else);
     if (stmt.else_expr) {
         current_context().on_stack--; // current result does not exist!
         visit(*stmt.else_expr);
     } else {
         emit(OpCode::NIL); // default return value!
     }
-    current_function()->patch_jump_destination(jump_to_end, current_program().size());
+    bind_label(jump_to_end);
 }
 
 void Compiler::literal_expr(const LiteralExpr& expr) {
@@ -733,6 +1002,83 @@ void Compiler::unary_expr(const UnaryExpr& expr) {
     }
 }
 
+namespace {
+    // opcode of binary operator which is not an assigment nor a logical operator
+    std::optional<OpCode> binary_opcode(const Token::Type type) {
+        switch (type) {
+            case Token::Type::PLUS: return OpCode::ADD;
+            case Token::Type::MINUS: return OpCode::SUBTRACT;
+            case Token::Type::STAR: return OpCode::MULTIPLY;
+            case Token::Type::SLASH: return OpCode::DIVIDE;
+            case Token::Type::EQUAL_EQUAL: return OpCode::EQUAL;
+            case Token::Type::BANG_EQUAL: return OpCode::NOT_EQUAL;
+            case Token::Type::LESS: return OpCode::LESS;
+            case Token::Type::LESS_EQUAL: return OpCode::LESS_EQUAL;
+            case Token::Type::GREATER: return OpCode::GREATER;
+            case Token::Type::GREATER_EQUAL: return OpCode::GREATER_EQUAL;
+            case Token::Type::GREATER_GREATER: return OpCode::RIGHT_SHIFT;
+            case Token::Type::LESS_LESS: return OpCode::LEFT_SHIFT;
+            case Token::Type::AND: return OpCode::BITWISE_AND;
+            case Token::Type::BAR: return OpCode::BITWISE_OR;
+            case Token::Type::CARET: return OpCode::BITWISE_XOR;
+            case Token::Type::PERCENT: return OpCode::MODULO;
+            case Token::Type::SLASH_SLASH: return OpCode::FLOOR_DIVISON;
+            default: return {};
+        }
+    }
+} // namespace
+
+std::optional<bite_byte> Compiler::frame_slot(const Expr& expr) {
+    if (!expr.is_variable_expr()) {
+        return {};
+    }
+    const Binding& binding = static_cast<const VariableExpr&>(expr).binding;
+    if (auto* local = std::get_if<LocalBinding>(&binding)) {
+        // unknown slot is left to the generic path
+        auto slot = current_context().slots.find(local->info->idx);
+        if (slot == current_context().slots.end()) {
+            return {};
+        }
+        return static_cast<bite_byte>(slot->second.index);
+    }
+    if (auto* parameter = std::get_if<ParameterBinding>(&binding)) {
+        return static_cast<bite_byte>(parameter->idx + 1); // + 1 for the reserved receiver object
+    }
+    return {};
+}
+
+// Operands which are variables in current frame or literals are read by the operation itself
+// instead of being pushed by separate instructions which saves dispatch of one or two instructions.
+bool Compiler::slot_binary_expr(const BinaryExpr& expr) {
+    auto opcode = binary_opcode(expr.op);
+    if (!opcode) {
+        return false;
+    }
+    auto left = frame_slot(*expr.left);
+    if (!left) {
+        return false;
+    }
+    if (auto right = frame_slot(*expr.right)) {
+        emit(OpCode::BINARY_SLOTS);
+        emit(static_cast<bite_byte>(*opcode));
+        emit(*left);
+        emit(*right);
+    } else if (expr.right->is_literal_expr()) {
+        int constant = current_function()->add_constant(static_cast<const LiteralExpr&>(*expr.right).value);
+        emit(OpCode::BINARY_SLOT_CONSTANT);
+        emit(static_cast<bite_byte>(*opcode));
+        emit(*left);
+        emit(constant);
+    } else {
+        return false;
+    }
+    // both operands are pushed before the operation replaces them with its result
+    current_context().on_stack++;
+    current_context().on_stack++;
+    current_context().on_stack--;
+    return true;
+}
+
 void Compiler::binary_expr(const BinaryExpr& expr) {
     // we don't need to actually visit lhs for plain assigment
     if (expr.op == Token::Type::EQUAL) {
@@ -742,28 +1088,33 @@ void Compiler::binary_expr(const BinaryExpr& expr) {
             visit(*expr.left->as_get_property_expr()->left);
         }
         emit_set_variable(expr.binding);
-        current_context().on_stack--;
         return;
     }
+    #ifdef BITE_SLOT_OPERANDS
+    if (slot_binary_expr(expr)) {
+        return;
+    }
+    #endif
     visit(*expr.left);
     // we need handle logical expressions before we execute right side as they can short circut
     if (expr.op == Token::Type::AND_AND || expr.op == Token::Type::BAR_BAR || expr.op ==
         Token::Type::QUESTION_QUESTION) {
         logical_expr(expr);
-        current_context().on_stack--;
         return;
     }
 
     if (expr.op == Token::Type::QUESTION_QUESTION_EQUAL) {
-        auto jump_to_end = current_function()->add_empty_jump_destination();
-        emit(OpCode::JUMP_IF_NOT_NIL, jump_to_end);
+        auto jump_to_end = new_label();
+        emit_jump(OpCode::JUMP_IF_NOT_NIL, jump_to_end);
+        // nil value is replaced by the assigned one
+        emit(OpCode::POP);
+        current_context().on_stack--;
         visit(*expr.right);
         if (expr.left->is_get_property_expr()) {
             visit(*expr.left->as_get_property_expr()->left);
         }
         emit_set_variable(expr.binding);
-        current_context().on_stack--;
-        current_function()->patch_jump_destination(jump_to_end, current_program().size());
+        bind_label(jump_to_end);
         return;
     }
 
@@ -779,41 +1130,13 @@ void Compiler::binary_expr(const BinaryExpr& expr) {
         }
     };
 
+    if (auto opcode = binary_opcode(expr.op)) {
+        emit(*opcode);
+        current_context().on_stack--;
+        return;
+    }
+
     switch (expr.op) {
-        case Token::Type::PLUS: emit(OpCode::ADD);
-            break;
-        case Token::Type::MINUS: emit(OpCode::SUBTRACT);
-            break;
-        case Token::Type::STAR: emit(OpCode::MULTIPLY);
-            break;
-        case Token::Type::SLASH: emit(OpCode::DIVIDE);
-            break;
-        case Token::Type::EQUAL_EQUAL: emit(OpCode::EQUAL);
-            break;
-        case Token::Type::BANG_EQUAL: emit(OpCode::NOT_EQUAL);
-            break;
-        case Token::Type::LESS: emit(OpCode::LESS);
-            break;
-        case Token::Type::LESS_EQUAL: emit(OpCode::LESS_EQUAL);
-            break;
-        case Token::Type::GREATER: emit(OpCode::GREATER);
-            break;
-        case Token::Type::GREATER_EQUAL: emit(OpCode::GREATER_EQUAL);
-            break;
-        case Token::Type::GREATER_GREATER: emit(OpCode::RIGHT_SHIFT);
-            break;
-        case Token::Type::LESS_LESS: emit(OpCode::LEFT_SHIFT);
-            break;
-        case Token::Type::AND: emit(OpCode::BITWISE_AND);
-            break;
-        case Token::Type::BAR: emit(OpCode::BITWISE_OR);
-            break;
-        case Token::Type::CARET: emit(OpCode::BITWISE_XOR);
-            break;
-        case Token::Type::PERCENT: emit(OpCode::MODULO);
-            break;
-        case Token::Type::SLASH_SLASH: emit(OpCode::FLOOR_DIVISON);
-            break;
         case Token::Type::PLUS_EQUAL: emit(OpCode::ADD);
             fix();
             emit_set_variable(expr.binding);
@@ -874,25 +1197,37 @@ void Compiler::emit_set_variable(const Binding& binding) {
                 emit(OpCode::SET_GLOBAL, constant);
             },
             [this](const UpvalueBinding& bind) {
-                emit(OpCode::SET_UPVALUE, bind.idx);
+                if (const auto& enclosing_slots = current_context().enclosing_slots) {
+                    emit(OpCode::SET_ENCLOSING_SLOT, (*enclosing_slots)[bind.idx]);
+                } else {
+                    emit(OpCode::SET_UPVALUE, bind.idx);
+                }
             },
             [this](const MemberBinding& bind) {
                 emit(OpCode::THIS);
+                current_context().on_stack++;
                 emit(OpCode::SET_PROPERTY, current_function()->add_constant(*bind.name));
+                current_context().on_stack--;
             },
             [this](const ParameterBinding& bind) {
                 emit(OpCode::SET, bind.idx + 1); // + 1 for the reserved receiver object
             },
             [this](const ClassObjectBinding& bind) {
                 emit_get_variable(*bind.class_binding);
+                current_context().on_stack++;
                 emit(OpCode::SET_PROPERTY, current_function()->add_constant(*bind.name));
+                current_context().on_stack--;
             },
             [this](const PropertyBinding& bind) {
+                // pops the object pushed by the assignment
                 emit(OpCode::SET_PROPERTY, current_function()->add_constant(*bind.property));
+                current_context().on_stack--;
             },
             [this](const SuperBinding& bind) {
                 emit(OpCode::THIS);
+                current_context().on_stack++;
                 emit(OpCode::SET_SUPER, current_function()->add_constant(*bind.property));
+                current_context().on_stack--;
             },
             [this](const NoBinding) {
                 std::unreachable(); // panic!
@@ -913,7 +1248,11 @@ void Compiler::emit_get_variable(const Binding& binding) {
                 emit(OpCode::GET_GLOBAL, constant);
             },
             [this](const UpvalueBinding& bind) {
-                emit(OpCode::GET_UPVALUE, bind.idx);
+                if (const auto& enclosing_slots = current_context().enclosing_slots) {
+                    emit(OpCode::GET_ENCLOSING_SLOT, (*enclosing_slots)[bind.idx]);
+                } else {
+                    emit(OpCode::GET_UPVALUE, bind.idx);
+                }
             },
             [this](const MemberBinding& bind) {
                 emit(OpCode::THIS);
@@ -946,7 +1285,7 @@ void Compiler::variable_expr(const VariableExpr& expr) {
 }
 
 void Compiler::logical_expr(const BinaryExpr& expr) {
-    int jump = current_function()->add_empty_jump_destination();
+    int jump = new_label();
     OpCode jump_opcode;
     if (expr.op == Token::Type::AND_AND) {
         jump_opcode = OpCode::JUMP_IF_FALSE;
@@ -957,11 +1296,11 @@ void Compiler::logical_expr(const BinaryExpr& expr) {
     } else {
         BITE_PANIC("invalid logical expr operator");
     }
-    emit(jump_opcode, jump);
+    emit_jump(jump_opcode, jump);
     emit(OpCode::POP);
     current_context().on_stack--;
     visit(*expr.right);
-    current_function()->patch_jump_destination(jump, current_program().size());
+    bind_label(jump);
 }
 
 void Compiler::call_expr(const CallExpr& expr) {
@@ -976,32 +1315,40 @@ void Compiler::call_expr(const CallExpr& expr) {
 
 void Compiler::safe_call_expr(const SafeCallExpr& expr) {
     visit(*expr.callee);
-    int jump_to_end = current_function()->add_empty_jump_destination();
-    emit(OpCode::JUMP_IF_NIL, jump_to_end);
+    int jump_to_end = new_label();
+    emit_jump(OpCode::JUMP_IF_NIL, jump_to_end);
     for (auto& argument : expr.arguments) {
         visit(*argument);
     }
     auto arguments_size = std::ranges::distance(expr.arguments);
     emit(OpCode::CALL, arguments_size);
     current_context().on_stack -= arguments_size;
-    current_function()->patch_jump_destination(jump_to_end, current_program().size());
+    bind_label(jump_to_end);
 }
 
 void Compiler::get_property_expr(const GetPropertyExpr& expr) {
-    visit(*expr.left);
     std::string name = *expr.property.string;
+    // superinstruction for GET followed by GET_PROPERTY
+    if (auto slot = frame_slot(*expr.left)) {
+        int constant = current_function()->add_constant(name);
+        emit(OpCode::GET_SLOT_PROPERTY, *slot);
+        emit(constant);
+        current_context().on_stack++;
+        return;
+    }
+    visit(*expr.left);
     int constant = current_function()->add_constant(name);
     emit(OpCode::GET_PROPERTY, constant);
 }
 
 void Compiler::safe_get_property_expr(const SafeGetPropertyExpr& expr) {
-    auto jump_idx = current_function()->add_empty_jump_destination();
+    auto jump_idx = new_label();
     visit(*expr.left);
-    emit(OpCode::JUMP_IF_NIL, jump_idx);
+    emit_jump(OpCode::JUMP_IF_NIL, jump_idx);
     std::string name = *expr.property.string;
     int constant = current_function()->add_constant(name);
     emit(OpCode::GET_PROPERTY, constant);
-    current_function()->patch_jump_destination(jump_idx, current_program().size());
+    bind_label(jump_idx);
 }
 
 
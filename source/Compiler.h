@@ -1,5 +1,6 @@
 #ifndef COMPILER_H
 #define COMPILER_H
+#include <algorithm>
 
 #include "Analyzer.h"
 #include "Ast.h"
@@ -53,15 +54,56 @@ public:
         bool is_captured;
     };
 
+    // jump target inside current function, jumps emitted before it is bound are patched once it is bound
+    struct Label {
+        std::optional<std::size_t> destination;
+        std::vector<std::size_t> pending_jumps; // positions of 16-bit offset operands
+        std::vector<std::size_t> pending_long_jumps; // positions of 32-bit offset operands in jump islands
+    };
+
+    // current depth of function value stack which also remembers the deepest point reached
+    struct StackDepth {
+        StackDepth& operator=(const std::int64_t depth) {
+            current = depth;
+            max = std::max(max, depth);
+            return *this;
+        }
+
+        void operator++(int) {
+            *this = current + 1;
+        }
+
+        void operator--(int) {
+            --current;
+        }
+
+        StackDepth& operator-=(const std::int64_t count) {
+            current -= count;
+            return *this;
+        }
+
+        operator std::int64_t() const { // NOLINT(*-explicit-constructor)
+            return current;
+        }
+
+        std::int64_t current = 0;
+        std::int64_t max = 0;
+    };
+
     struct Context {
         Function* function = nullptr;
         FunctionType function_type;
         std::vector<Upvalue> upvalues;
-        std::int64_t on_stack = 0;
+        StackDepth on_stack;
         // enviroment offset to slot
         bite::unordered_dense::map<std::uint64_t, Slot> slots;
         std::vector<ExpressionScope> expression_scopes;
         bite::unordered_dense::set<int64_t> open_upvalues_slots;
+        std::vector<Label> labels;
+        // program size at which some pending jump could get out of range of 16-bit offset
+        std::size_t next_island_check = SIZE_MAX;
+        // when set upvalues are read directly from enclosing frame, indexed by upvalue index
+        std::optional<std::vector<bite_byte>> enclosing_slots;
     };
 
     // perfomance?
@@ -141,14 +183,13 @@ public:
     }
 
 
-    explicit Compiler(SharedContext* context) :
-        main(new Function("main", 0, 0)),
-        shared_context(context) {
-        context_stack.emplace_back(main, FunctionType::FUNCTION);
-        functions.push_back(main);
-    }
+    explicit Compiler(SharedContext* context) : shared_context(context) {}
 
+    // returns false when some function can't be encoded, reasons are in get_errors()
     bool compile(Ast* ast);
+    // compiles body of function deferred until its first call, on failure function stays lazy
+    bool compile_lazy(Function* function);
+    [[nodiscard]] const std::vector<Error>& get_errors() const;
 
     Function* get_main();
 
@@ -168,6 +209,10 @@ public:
     void anonymous_function_expr(const AnonymousFunctionExpr& expr);
     void string_interpolation_expr(const StringInterpolationExpr& expr);
     void function(const FunctionDeclaration& stmt, FunctionType type);
+    void function_body(const FunctionDeclaration& stmt);
+    std::optional<std::vector<bite_byte>> enclosing_frame_slots(const FunctionDeclaration& stmt);
+    std::optional<bite_byte> frame_slot(const Expr& expr);
+    bool slot_binary_expr(const BinaryExpr& expr);
 
     void constructor(const Constructor& stmt, const std::vector<Field>& fields, bool has_superclass);
 
@@ -210,6 +255,7 @@ public:
 private:
     void start_context(Function* function, FunctionType type);
     void end_context();
+    void check_constants(Function* function);
     Context& current_context();
     // Scope& current_scope();
     [[nodiscard]] Function* current_function();
@@ -219,6 +265,12 @@ private:
     void emit(OpCode op_code);
     void emit(OpCode op_code, bite_byte value);
     void emit_default_return();
+    int new_label();
+    void bind_label(int label);
+    void emit_jump(OpCode op_code, int label);
+    void emit_jump_island();
+    void patch_jump(std::size_t position, std::size_t destination);
+    void patch_long_jump(std::size_t position, std::size_t destination);
 
     void define_variable(const DeclarationInfo& info);
     int64_t synthetic_variable();
@@ -228,11 +280,12 @@ private:
 
     void emit_get_variable(const Binding& binding);
 
-    Function* main;
+    Function* main = nullptr;
     std::vector<Context> context_stack;
     std::vector<Function*> functions;
     SharedContext* shared_context;
-    Ast* ast;
+    Ast* ast = nullptr;
+    std::vector<Error> errors;
 };
 
 
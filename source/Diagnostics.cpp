@@ -1,6 +1,5 @@
 #include "Diagnostics.h"
 
-#include <fstream>
 #include <algorithm>
 
 #include "base/debug.h"
@@ -82,32 +81,17 @@ struct CompiledInlineHintsFile {
 };
 
 
-CompiledInlineHint compile_inline_hint(const InlineHint& hint) {
-    // TODO: optimizations (note: displaying these hints is not performance critical as we probably abort after anyways)
-    std::ifstream file(*hint.location.file_path);
-    BITE_ASSERT(file.is_open());
-    std::int64_t file_offset = 0;
-    std::string line;
-    std::int64_t line_number = 0;
-    while (std::getline(file, line)) {
-        line_number++;
-        file_offset += static_cast<std::int64_t>(line.size()) + 1;
-        if (file_offset > hint.location.start_offset) {
-            std::int64_t in_line_start = hint.location.start_offset - file_offset + static_cast<std::int64_t>(line.
-                size()) + 1;
-            return CompiledInlineHint {
-                    .line_number = line_number,
-                    .line = line,
-                    .in_line_location = {
-                        in_line_start,
-                        in_line_start + hint.location.end_offset - hint.location.start_offset
-                    },
-                    .message = hint.message,
-                    .level = hint.level
-                };
-        }
-    }
-    BITE_PANIC("diagnostic inline hint compilation failed");
+CompiledInlineHint compile_inline_hint(const InlineHint& hint, const FileTable& files, SourceCache& sources) {
+    const SourceFile* file = sources.get(files.path_of(hint.location.file_id));
+    BITE_ASSERT(file != nullptr);
+    auto [line_number, in_line_start] = file->location(hint.location.start_offset);
+    return CompiledInlineHint {
+            .line_number = line_number,
+            .line = std::string(file->line(line_number)),
+            .in_line_location = { in_line_start, in_line_start + hint.location.end_offset - hint.location.start_offset },
+            .message = hint.message,
+            .level = hint.level
+        };
 }
 
 void print_hint_path(
@@ -213,23 +197,29 @@ void print_hint_file(CompiledInlineHintsFile& file, std::ostream& output, bool i
     }
 }
 
-void print_diagnostic(const Diagnostic& diagnostic, std::ostream& output, bool is_terminal) {
+void print_diagnostic(
+    const Diagnostic& diagnostic,
+    const FileTable& files,
+    SourceCache& sources,
+    std::ostream& output,
+    bool is_terminal
+) {
     print_diagnostic_message(diagnostic, output, is_terminal);
-    unordered_dense::map<StringTable::Handle, std::vector<CompiledInlineHint>> compiled_hints;
+    unordered_dense::map<FileTable::Id, std::vector<CompiledInlineHint>> compiled_hints;
     for (const auto& inline_hint : diagnostic.inline_hints) {
-        compiled_hints[inline_hint.location.file_path].push_back(compile_inline_hint(inline_hint));
+        compiled_hints[inline_hint.location.file_id].push_back(compile_inline_hint(inline_hint, files, sources));
     }
     std::vector<CompiledInlineHintsFile> compiled_hint_files;
     for (auto& [file, hints] : compiled_hints) {
-        compiled_hint_files.emplace_back(file, std::move(hints));
+        compiled_hint_files.emplace_back(files.path_of(file), std::move(hints));
     }
     for (auto& file : compiled_hint_files) {
         print_hint_file(file, output, is_terminal);
     }
 }
 
-void DiagnosticManager::print(std::ostream& output, bool is_terminal) {
+void DiagnosticManager::print(const FileTable& files, SourceCache& sources, std::ostream& output, bool is_terminal) {
     for (const auto& diagnostic : diagnostics) {
-        print_diagnostic(diagnostic, output, is_terminal);
+        print_diagnostic(diagnostic, files, sources, output, is_terminal);
     }
 }
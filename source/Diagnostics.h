@@ -4,26 +4,35 @@
 
 #ifndef DIAGNOSTICS_H
 #define DIAGNOSTICS_H
+#include <iterator>
 #include <string>
+#include <utility>
 #include <vector>
 #include <filesystem>
 
 #include "base/debug.h"
+#include "shared/FileTable.h"
+#include "shared/SourceCache.h"
 #include "shared/StringTable.h"
 
 namespace bite {
+    // embedded in every token and ast node so it is kept small, offsets limit source files to 4 GiB
     struct SourceSpan {
-        std::int64_t start_offset;
-        std::int64_t end_offset;
-        StringTable::Handle file_path;
+        static constexpr std::uint32_t MAX_OFFSET = UINT32_MAX;
+
+        std::uint32_t start_offset;
+        std::uint32_t end_offset;
+        FileTable::Id file_id;
 
         void merge(const SourceSpan& other) {
-            BITE_ASSERT(this->file_path == other.file_path);
+            BITE_ASSERT(this->file_id == other.file_id);
             this->start_offset = std::min(this->start_offset, other.start_offset);
             this->end_offset = std::max(this->end_offset, other.end_offset);
         }
     };
 
+    static_assert(sizeof(SourceSpan) == 12);
+
     enum class DiagnosticLevel : std::uint8_t {
         INFO,
         WARNING,
@@ -49,7 +58,23 @@ namespace bite {
             diagnostics.push_back(diagnostic);
         }
 
-        void print(std::ostream& output, bool is_terminal = false);
+        // appends diagnostics collected separately (for example by parser running on another thread)
+        void merge(DiagnosticManager&& other) {
+            diagnostics.insert(
+                diagnostics.end(),
+                std::make_move_iterator(other.diagnostics.begin()),
+                std::make_move_iterator(other.diagnostics.end())
+            );
+            other.diagnostics.clear();
+        }
+
+        // moves collected diagnostics out, f.e. to attribute them to parts of incrementally analyzed document
+        std::vector<Diagnostic> take() {
+            return std::exchange(diagnostics, {});
+        }
+
+        // source lines of inline hints are looked up in sources
+        void print(const FileTable& files, SourceCache& sources, std::ostream& output, bool is_terminal = false);
 
     private:
         std::vector<Diagnostic> diagnostics;
@@ -42,27 +42,25 @@ public:
     [[nodiscard]] int get_upvalue_count() const { return upvalue_count; }
     void set_upvalue_count(const int count) { upvalue_count = count; }
 
-    int add_empty_jump_destination() {
-        jump_table.push_back(0);
-        return jump_table.size() - 1;
-    }
+    // deepest value stack used by function frame, including arguments and receiver slot
+    [[nodiscard]] int get_max_stack() const { return max_stack; }
+    void set_max_stack(const int depth) { max_stack = depth; }
 
-    void patch_jump_destination(int idx, uint32_t destination) {
-        assert(idx < jump_table.size());
-        jump_table[idx] = destination;
-    }
+    // declaration of function which body compilation was deferred until its first call
+    [[nodiscard]] bool is_compiled() const { return lazy_declaration == nullptr; }
+    [[nodiscard]] const FunctionDeclaration* get_lazy_declaration() const { return lazy_declaration; }
+    void set_lazy_declaration(const FunctionDeclaration* declaration) { lazy_declaration = declaration; }
 
-    int add_jump_destination(uint32_t destination) {
-        jump_table.push_back(destination);
-        return jump_table.size() - 1;
-    }
+    std::vector<Value>& get_constants();
 
-    uint32_t get_jump_destination(int idx) {
-        assert(idx < jump_table.size());
-        return jump_table[idx];
-    }
+    // resolved addresses of globals which names are stored in constants, indexed by constant index
+    // valid only for VM which filled it
+    struct GlobalCache {
+        std::uint64_t vm_id = 0;
+        std::vector<Value*> entries;
+    };
 
-    std::vector<Value>& get_constants();
+    GlobalCache& get_global_cache() { return global_cache; }
 
     void add_allocated(Object* object);
 
@@ -95,8 +93,10 @@ private:
     int max_arity;
     Program program; // code of function
     std::vector<Value> constants;
-    std::vector<uint32_t> jump_table;
     int upvalue_count { 0 };
+    int max_stack { 0 };
+    const FunctionDeclaration* lazy_declaration = nullptr;
+    GlobalCache global_cache;
 };
 
 struct ForeignFunction;
@@ -136,6 +136,8 @@ public:
 
     Value* location = nullptr;
     Value closed = Value { nil_t };
+    // next open upvalue deeper in vm stack, unused once closed
+    Upvalue* next = nullptr;
 };
 
 class Closure final : public Object {
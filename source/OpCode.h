@@ -63,7 +63,92 @@ enum class OpCode : bite_byte {
     ,
     JUMP_IF_NIL,
     JUMP_IF_NOT_NIL,
-    JUMP_IF_NOT_UNDEFINED
+    JUMP_IF_NOT_UNDEFINED,
+    // binary operation on frame slots: operation opcode, left slot, right slot
+    BINARY_SLOTS,
+    // binary operation on frame slot and constant: operation opcode, left slot, right constant
+    BINARY_SLOT_CONSTANT,
+    // superinstructions
+    POP_JUMP_IF_FALSE, // JUMP_IF_FALSE with condition popped on both paths
+    GET_SLOT_PROPERTY, // GET followed by GET_PROPERTY: slot, name constant
+    TAIL_CALL, // CALL which result is returned, reuses frame of caller
+    GET_ENCLOSING_SLOT, // upvalue access of immediately invoked function: slot in the frame below
+    SET_ENCLOSING_SLOT,
+    JUMP_LONG // JUMP with 32-bit offset, for targets out of range of 16-bit offset
 };
 
+// used by opcode profiling
+constexpr const char* opcode_name(const OpCode opcode) {
+    switch (opcode) {
+        case OpCode::ADD: return "ADD";
+        case OpCode::MULTIPLY: return "MULTIPLY";
+        case OpCode::SUBTRACT: return "SUBTRACT";
+        case OpCode::DIVIDE: return "DIVIDE";
+        case OpCode::NEGATE: return "NEGATE";
+        case OpCode::TRUE: return "TRUE";
+        case OpCode::FALSE: return "FALSE";
+        case OpCode::NIL: return "NIL";
+        case OpCode::CONSTANT: return "CONSTANT";
+        case OpCode::EQUAL: return "EQUAL";
+        case OpCode::NOT_EQUAL: return "NOT_EQUAL";
+        case OpCode::LESS: return "LESS";
+        case OpCode::LESS_EQUAL: return "LESS_EQUAL";
+        case OpCode::GREATER: return "GREATER";
+        case OpCode::GREATER_EQUAL: return "GREATER_EQUAL";
+        case OpCode::LEFT_SHIFT: return "LEFT_SHIFT";
+        case OpCode::RIGHT_SHIFT: return "RIGHT_SHIFT";
+        case OpCode::BITWISE_AND: return "BITWISE_AND";
+        case OpCode::BITWISE_OR: return "BITWISE_OR";
+        case OpCode::BITWISE_XOR: return "BITWISE_XOR";
+        case OpCode::POP: return "POP";
+        case OpCode::GET: return "GET";
+        case OpCode::SET: return "SET";
+        case OpCode::JUMP_IF_FALSE: return "JUMP_IF_FALSE";
+        case OpCode::JUMP: return "JUMP";
+        case OpCode::JUMP_IF_TRUE: return "JUMP_IF_TRUE";
+        case OpCode::NOT: return "NOT";
+        case OpCode::BINARY_NOT: return "BINARY_NOT";
+        case OpCode::MODULO: return "MODULO";
+        case OpCode::FLOOR_DIVISON: return "FLOOR_DIVISON";
+        case OpCode::CALL: return "CALL";
+        case OpCode::RETURN: return "RETURN";
+        case OpCode::CLOSURE: return "CLOSURE";
+        case OpCode::GET_UPVALUE: return "GET_UPVALUE";
+        case OpCode::SET_UPVALUE: return "SET_UPVALUE";
+        case OpCode::CLOSE_UPVALUE: return "CLOSE_UPVALUE";
+        case OpCode::CLASS: return "CLASS";
+        case OpCode::GET_PROPERTY: return "GET_PROPERTY";
+        case OpCode::SET_PROPERTY: return "SET_PROPERTY";
+        case OpCode::METHOD: return "METHOD";
+        case OpCode::INHERIT: return "INHERIT";
+        case OpCode::GET_SUPER: return "GET_SUPER";
+        case OpCode::GET_NATIVE: return "GET_NATIVE";
+        case OpCode::FIELD: return "FIELD";
+        case OpCode::THIS: return "THIS";
+        case OpCode::CALL_SUPER_CONSTRUCTOR: return "CALL_SUPER_CONSTRUCTOR";
+        case OpCode::CONSTRUCTOR: return "CONSTRUCTOR";
+        case OpCode::ABSTRACT_CLASS: return "ABSTRACT_CLASS";
+        case OpCode::SET_SUPER: return "SET_SUPER";
+        case OpCode::TRAIT: return "TRAIT";
+        case OpCode::TRAIT_METHOD: return "TRAIT_METHOD";
+        case OpCode::GET_TRAIT: return "GET_TRAIT";
+        case OpCode::SET_GLOBAL: return "SET_GLOBAL";
+        case OpCode::GET_GLOBAL: return "GET_GLOBAL";
+        case OpCode::IMPORT: return "IMPORT";
+        case OpCode::CLASS_CLOSURE: return "CLASS_CLOSURE";
+        case OpCode::JUMP_IF_NIL: return "JUMP_IF_NIL";
+        case OpCode::JUMP_IF_NOT_NIL: return "JUMP_IF_NOT_NIL";
+        case OpCode::JUMP_IF_NOT_UNDEFINED: return "JUMP_IF_NOT_UNDEFINED";
+        case OpCode::BINARY_SLOTS: return "BINARY_SLOTS";
+        case OpCode::BINARY_SLOT_CONSTANT: return "BINARY_SLOT_CONSTANT";
+        case OpCode::POP_JUMP_IF_FALSE: return "POP_JUMP_IF_FALSE";
+        case OpCode::GET_SLOT_PROPERTY: return "GET_SLOT_PROPERTY";
+        case OpCode::TAIL_CALL: return "TAIL_CALL";
+        case OpCode::GET_ENCLOSING_SLOT: return "GET_ENCLOSING_SLOT";
+        case OpCode::SET_ENCLOSING_SLOT: return "SET_ENCLOSING_SLOT";
+        case OpCode::JUMP_LONG: return "JUMP_LONG";
+    }
+    return "UNKNOWN";
+}
+
 #endif //OPCODE_H
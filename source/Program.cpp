@@ -1,21 +1,29 @@
 #include "Program.h"
 
+#include "base/debug.h"
+
 void Program::write(OpCode op_code) {
     write(static_cast<bite_byte>(op_code));
 }
 
 void Program::write(bite_byte byte) {
+    BITE_ASSERT(!is_external());
     code.push_back(byte);
 }
 
 void Program::patch(int position, bite_byte byte) {
+    BITE_ASSERT(!is_external());
     code[position] = byte; // range check?
 }
 
 std::size_t Program::size() const {
-    return code.size();
+    return get_code().size();
 }
 
 uint8_t Program::get_at(int idx) {
-    return code[idx];
+    return is_external() ? external_code[idx] : code[idx];
+}
+
+std::span<const bite_byte> Program::get_code() const {
+    return is_external() ? external_code : std::span<const bite_byte>(code);
 }
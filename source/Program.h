@@ -1,6 +1,7 @@
 #ifndef PROGRAM_H
 #define PROGRAM_H
 #include <cstdint>
+#include <span>
 #include <vector>
 
 #include "OpCode.h"
@@ -8,6 +9,11 @@
 
 class Program {
 public:
+    Program() = default;
+
+    // non-owning program, code is owned by someone else (e.g. memory mapped bytecode image)
+    explicit Program(std::span<const bite_byte> external_code) : external_code(external_code) {}
+
     void write(OpCode op_code);
     void write(bite_byte byte);
 
@@ -17,8 +23,15 @@ public:
 
     uint8_t get_at(int idx);
 
+    [[nodiscard]] std::span<const bite_byte> get_code() const;
+
 private:
+    [[nodiscard]] bool is_external() const {
+        return external_code.data() != nullptr;
+    }
+
     std::vector<bite_byte> code;
+    std::span<const bite_byte> external_code;
 };
 
 
@@ -2,12 +2,69 @@
 
 #include <iostream>
 #include <algorithm>
+#include <ranges>
 
+#include "base/debug.h"
 #include "base/overloaded.h"
+#include "base/unordered_dense.h"
 #include "shared/SharedContext.h"
 
 // TODO: maybe add asserts
 
+#ifdef BITE_PROFILE_OPCODES
+namespace {
+    // Counts executed opcodes together with sequences of two and three consecutive opcodes,
+    // most frequent sequences are candidates for superinstructions. Printed at exit.
+    struct OpcodeProfile {
+        static constexpr std::size_t REPORTED_SEQUENCES = 20;
+
+        void record(OpCode opcode) {
+            auto code = static_cast<std::uint32_t>(opcode);
+            ++counts[code];
+            if (length >= 1) {
+                ++pairs[previous[1] << 8 | code];
+            }
+            if (length >= 2) {
+                ++triples[previous[0] << 16 | previous[1] << 8 | code];
+            }
+            previous[0] = previous[1];
+            previous[1] = code;
+            length = std::min(length + 1, 2);
+        }
+
+        ~OpcodeProfile() {
+            report("opcodes", counts, 1);
+            report("pairs", pairs, 2);
+            report("triples", triples, 3);
+        }
+
+    private:
+        static void report(
+            const std::string& title,
+            const bite::unordered_dense::map<std::uint32_t, std::uint64_t>& sequences,
+            int length
+        ) {
+            std::vector<std::pair<std::uint32_t, std::uint64_t>> sorted(sequences.begin(), sequences.end());
+            std::ranges::sort(sorted, std::ranges::greater {}, &std::pair<std::uint32_t, std::uint64_t>::second);
+            std::cerr << "--- most frequent " << title << " ---\n";
+            for (const auto& [sequence, count] : sorted | std::views::take(REPORTED_SEQUENCES)) {
+                std::cerr << count << ':';
+                for (int i = length - 1; i >= 0; --i) {
+                    std::cerr << ' ' << opcode_name(static_cast<OpCode>(sequence >> i * 8 & 0xff));
+                }
+                std::cerr << '\n';
+            }
+        }
+
+        bite::unordered_dense::map<std::uint32_t, std::uint64_t> counts;
+        bite::unordered_dense::map<std::uint32_t, std::uint64_t> pairs;
+        bite::unordered_dense::map<std::uint32_t, std::uint64_t> triples;
+        std::uint32_t previous[2] {};
+        int length = 0;
+    } opcode_profile;
+} // namespace
+#endif
+
 uint8_t VM::fetch() {
     CallFrame& frame = frames.back();
     return frame.closure->get_function()->get_program().get_at(frame.instruction_pointer++);
@@ -18,19 +75,24 @@ OpCode VM::fetch_opcode() {
 }
 
 uint16_t VM::fetch_short() {
-    return static_cast<uint16_t>(fetch()) << 8 | fetch();
+    // operands of | are unsequenced so fetch them separately
+    uint16_t high = fetch();
+    uint16_t low = fetch();
+    return high << 8 | low;
 }
 
-void VM::jump_to(uint32_t pos) {
-    frames.back().instruction_pointer = pos;
+uint32_t VM::fetch_long() {
+    uint32_t high = fetch_short();
+    uint32_t low = fetch_short();
+    return high << 16 | low;
 }
 
-Value VM::get_constant(const int idx) const {
-    return frames.back().closure->get_function()->get_constant(idx);
+void VM::jump_by(const int32_t offset) {
+    frames.back().instruction_pointer += offset;
 }
 
-uint32_t VM::get_jump_destination(const int idx) const {
-    return frames.back().closure->get_function()->get_jump_destination(idx);
+Value VM::get_constant(const int idx) const {
+    return frames.back().closure->get_function()->get_constant(idx);
 }
 
 Value VM::pop() {
@@ -44,6 +106,7 @@ Value VM::peek(const int n) const {
 }
 
 void VM::push(const Value& value) {
+    BITE_ASSERT(stack_index < static_cast<int>(stack.size()));
     stack[stack_index++] = value;
 }
 
@@ -55,6 +118,24 @@ void VM::set_in_slot(const int index, const Value& value) {
     stack[frames.back().frame_pointer + index] = value;
 }
 
+Value& VM::get_global(const int constant_idx) {
+    Function* function = frames.back().closure->get_function();
+    auto& cache = function->get_global_cache();
+    if (cache.vm_id != id) {
+        cache.vm_id = id;
+        cache.entries.clear();
+    }
+    if (constant_idx >= static_cast<int>(cache.entries.size())) {
+        cache.entries.resize(constant_idx + 1, nullptr);
+    }
+    Value*& entry = cache.entries[constant_idx];
+    if (!entry) {
+        // TODO: what should happen if not present?
+        entry = &globals[std::get<std::string>(function->get_constants()[constant_idx])];
+    }
+    return *entry;
+}
+
 
 std::optional<VM::RuntimeError> VM::call_value(const Value& value, const int arguments_count) {
     // todo: refactor!
@@ -98,6 +179,15 @@ std::optional<VM::RuntimeError> VM::call_value(const Value& value, const int arg
         return res;
     }
     if (auto* closure = dynamic_cast<Closure*>(*object)) {
+        if (!closure->get_function()->is_compiled()) {
+            if (!context->compile_lazy(closure->get_function())) {
+                return RuntimeError("Function could not be compiled.");
+            }
+        }
+        // value might reference stack so it must not be used after this point
+        if (auto error = reserve_stack(closure->get_function())) {
+            return error;
+        }
         auto min_arity = closure->get_function()->get_min_arity();
         auto max_arity = closure->get_function()->get_max_arity();
         if (arguments_count < min_arity || arguments_count > max_arity) {
@@ -130,37 +220,60 @@ std::optional<VM::RuntimeError> VM::call_value(const Value& value, const int arg
     return RuntimeError("Expected callable value such as function or class.");
 }
 
+std::optional<VM::RuntimeError> VM::reserve_stack(const Function* function) {
+    std::size_t needed = stack_index + function->get_max_stack() + VM_TEMPORARIES;
+    if (needed <= stack.size()) {
+        return {};
+    }
+    if (needed > MAX_STACK_SIZE) {
+        return RuntimeError("Stack overflow.");
+    }
+    const Value* old_base = stack.data();
+    stack.resize(std::min(std::max(needed, stack.size() * 2), MAX_STACK_SIZE));
+    // open upvalues point directly into stack
+    for (auto* upvalue = open_upvalues; upvalue != nullptr; upvalue = upvalue->next) {
+        upvalue->location = stack.data() + (upvalue->location - old_base);
+    }
+    return {};
+}
+
+int VM::frame_stack_limit() const {
+    const CallFrame& frame = frames.back();
+    return frame.frame_pointer + frame.closure->get_function()->get_max_stack() + static_cast<int>(VM_TEMPORARIES);
+}
+
 Upvalue* VM::capture_upvalue(int index) {
     auto* value = &get_from_slot(index);
+    // captured locals are usually near the top of the stack so search is short
+    Upvalue* previous = nullptr;
+    Upvalue* upvalue = open_upvalues;
+    while (upvalue != nullptr && upvalue->location > value) {
+        previous = upvalue;
+        upvalue = upvalue->next;
+    }
     // try to reuse already open upvalue
-    Upvalue* upvalue = nullptr;
-    for (auto open : open_upvalues) {
-        if (open->location == value) {
-            upvalue = open;
-            break;
-        }
+    if (upvalue != nullptr && upvalue->location == value) {
+        return upvalue;
     }
-    if (upvalue == nullptr) {
-        upvalue = new Upvalue(value);
-        open_upvalues.push_back(upvalue);
-        allocate(upvalue);
+    auto* created = new Upvalue(value);
+    created->next = upvalue;
+    if (previous == nullptr) {
+        open_upvalues = created;
+    } else {
+        previous->next = created;
     }
-    return upvalue;
+    allocate(created);
+    return created;
 }
 
 void VM::close_upvalues(const Value& value) {
-    std::erase_if(
-        open_upvalues,
-        [&value](Upvalue* open) {
-            if (open->location >= &value) {
-                // maybe don't use memory addresses for this? seems unsafe
-                open->closed = *open->location;
-                open->location = &open->closed;
-                return true;
-            }
-            return false;
-        }
-    );
+    while (open_upvalues != nullptr && open_upvalues->location >= &value) {
+        Upvalue* upvalue = open_upvalues;
+        upvalue->closed = *upvalue->location;
+        upvalue->location = &upvalue->closed;
+        open_upvalues = upvalue->next;
+        upvalue->next = nullptr;
+    }
 }
 
 void VM::mark_roots_for_gc() {
@@ -176,8 +289,12 @@ void VM::mark_roots_for_gc() {
         gc->mark(global);
     }
 
-    for (auto* open_upvalue : open_upvalues) {
-        gc->mark(open_upvalue);
+    for (auto* upvalue = open_upvalues; upvalue != nullptr; upvalue = upvalue->next) {
+        gc->mark(upvalue);
+    }
+
+    for (auto* closure : shared_closures | std::views::values) {
+        gc->mark(closure);
     }
 
     gc->mark(int_class);
@@ -435,31 +552,66 @@ std::expected<Value, VM::RuntimeError> VM::run() {
     } \
         break; \
     }
+    // Primitive operands skip method lookup and allocation of bound method and receiver.
+    // Result must be exactly the same as of the corresponding method in core module!
+    #define INT_FAST_PATH(expr) \
+        if (peek(1).is<bite_int>() && peek().is<bite_int>()) { \
+            bite_int b = pop().get<bite_int>(); \
+            bite_int a = pop().get<bite_int>(); \
+            push(expr); \
+            break; \
+        }
+    #define NUMBER_FAST_PATH(expr) \
+        INT_FAST_PATH(expr) \
+        if (peek(1).is<bite_float>() && peek().is<bite_float>()) { \
+            bite_float b = pop().get<bite_float>(); \
+            bite_float a = pop().get<bite_float>(); \
+            push(expr); \
+            break; \
+        }
     while (true) {
-        switch (fetch_opcode()) {
+        // reserve_stack trusts compiled max stack depth, an under-counted depth fails here instead of writing past
+        // the end of the stack later
+        BITE_ASSERT(stack_index <= frame_stack_limit());
+        OpCode opcode = fetch_opcode();
+        #ifdef BITE_PROFILE_OPCODES
+        opcode_profile.record(opcode);
+        #endif
+    dispatch:
+        switch (opcode) {
             case OpCode::CONSTANT: {
                 uint8_t index = fetch();
                 push(get_constant(index));
                 break;
             }
-            case OpCode::ADD: BINARY_OPERATION(add)
-            case OpCode::MULTIPLY: BINARY_OPERATION(multiply)
-            case OpCode::SUBTRACT: BINARY_OPERATION(subtract)
-            case OpCode::DIVIDE: BINARY_OPERATION(divide)
-            case OpCode::EQUAL: BINARY_OPERATION(equals)
-            case OpCode::NOT_EQUAL: BINARY_OPERATION(not_equals)
-            case OpCode::LESS: BINARY_OPERATION(less)
-            case OpCode::LESS_EQUAL: BINARY_OPERATION(less_equal)
-            case OpCode::GREATER: BINARY_OPERATION(greater)
-            case OpCode::GREATER_EQUAL: BINARY_OPERATION(greater_equal)
-            case OpCode::RIGHT_SHIFT: BINARY_OPERATION(shift_right)
-            case OpCode::LEFT_SHIFT: BINARY_OPERATION(shift_left)
-            case OpCode::BITWISE_AND: BINARY_OPERATION(binary_and)
-            case OpCode::BITWISE_OR: BINARY_OPERATION(binary_or)
-            case OpCode::BITWISE_XOR: BINARY_OPERATION(binary_xor)
-            case OpCode::MODULO: BINARY_OPERATION(modulo)
-            case OpCode::FLOOR_DIVISON: BINARY_OPERATION(floor_divide)
+            case OpCode::ADD: NUMBER_FAST_PATH(a + b) BINARY_OPERATION(add)
+            case OpCode::MULTIPLY: NUMBER_FAST_PATH(a * b) BINARY_OPERATION(multiply)
+            case OpCode::SUBTRACT: NUMBER_FAST_PATH(a - b) BINARY_OPERATION(subtract)
+            case OpCode::DIVIDE: NUMBER_FAST_PATH(static_cast<bite_float>(a) / b) BINARY_OPERATION(divide)
+            case OpCode::EQUAL: NUMBER_FAST_PATH(a == b) BINARY_OPERATION(equals)
+            case OpCode::NOT_EQUAL: NUMBER_FAST_PATH(a != b) BINARY_OPERATION(not_equals)
+            case OpCode::LESS: NUMBER_FAST_PATH(a < b) BINARY_OPERATION(less)
+            case OpCode::LESS_EQUAL: NUMBER_FAST_PATH(a <= b) BINARY_OPERATION(less_equal)
+            case OpCode::GREATER: NUMBER_FAST_PATH(a > b) BINARY_OPERATION(greater)
+            case OpCode::GREATER_EQUAL: NUMBER_FAST_PATH(a >= b) BINARY_OPERATION(greater_equal)
+            case OpCode::RIGHT_SHIFT: INT_FAST_PATH(a >> b) BINARY_OPERATION(shift_right)
+            case OpCode::LEFT_SHIFT: INT_FAST_PATH(a << b) BINARY_OPERATION(shift_left)
+            case OpCode::BITWISE_AND: INT_FAST_PATH(a & b) BINARY_OPERATION(binary_and)
+            case OpCode::BITWISE_OR: INT_FAST_PATH(a | b) BINARY_OPERATION(binary_or)
+            case OpCode::BITWISE_XOR: INT_FAST_PATH(a ^ b) BINARY_OPERATION(binary_xor)
+            case OpCode::MODULO: INT_FAST_PATH(a % b) BINARY_OPERATION(modulo)
+            case OpCode::FLOOR_DIVISON: INT_FAST_PATH(a / b) BINARY_OPERATION(floor_divide)
             case OpCode::NEGATE: {
+                if (auto integer = peek().as<bite_int>()) {
+                    pop();
+                    push(-*integer);
+                    break;
+                }
+                if (auto number = peek().as<bite_float>()) {
+                    pop();
+                    push(-*number);
+                    break;
+                }
                 // TODO: change into nagate
                 auto a = pop();
                 Class* klass = get_class(a);
@@ -501,43 +653,55 @@ std::expected<Value, VM::RuntimeError> VM::run() {
                 break;
             }
             case OpCode::JUMP_IF_FALSE: {
-                int idx = fetch();
+                auto offset = static_cast<int16_t>(fetch_short());
                 if (!peek().get<bool>()) {
-                    jump_to(get_jump_destination(idx));
+                    jump_by(offset);
+                }
+                break;
+            }
+            case OpCode::POP_JUMP_IF_FALSE: {
+                auto offset = static_cast<int16_t>(fetch_short());
+                if (!pop().get<bool>()) {
+                    jump_by(offset);
                 }
                 break;
             }
             case OpCode::JUMP_IF_NIL: {
-                int idx = fetch();
+                auto offset = static_cast<int16_t>(fetch_short());
                 if (peek().is<Nil>()) {
-                    jump_to(get_jump_destination(idx));
+                    jump_by(offset);
                 }
                 break;
             }
             case OpCode::JUMP_IF_NOT_NIL: {
-                int idx = fetch();
+                auto offset = static_cast<int16_t>(fetch_short());
                 if (!peek().is<Nil>()) {
-                    jump_to(get_jump_destination(idx));
+                    jump_by(offset);
                 }
                 break;
             }
             case OpCode::JUMP_IF_TRUE: {
-                int idx = fetch();
+                auto offset = static_cast<int16_t>(fetch_short());
                 if (peek().get<bool>()) {
-                    jump_to(get_jump_destination(idx));
+                    jump_by(offset);
                 }
                 break;
             }
             case OpCode::JUMP_IF_NOT_UNDEFINED: {
-                int idx = fetch();
+                auto offset = static_cast<int16_t>(fetch_short());
                 if (!peek().is<Undefined>()) {
-                    jump_to(get_jump_destination(idx));
+                    jump_by(offset);
                 }
                 break;
             }
             case OpCode::JUMP: {
-                int idx = fetch();
-                jump_to(get_jump_destination(idx));
+                auto offset = static_cast<int16_t>(fetch_short());
+                jump_by(offset);
+                break;
+            }
+            case OpCode::JUMP_LONG: {
+                auto offset = static_cast<int32_t>(fetch_long());
+                jump_by(offset);
                 break;
             }
             case OpCode::NOT: {
@@ -548,6 +712,11 @@ std::expected<Value, VM::RuntimeError> VM::run() {
                 break;
             }
             case OpCode::BINARY_NOT: {
+                if (auto integer = peek().as<bite_int>()) {
+                    pop();
+                    push(~*integer);
+                    break;
+                }
                 auto a = pop();
                 Class* klass = get_class(a);
                 ClassValue method = klass->methods["binary_not"];
@@ -567,6 +736,27 @@ std::expected<Value, VM::RuntimeError> VM::run() {
                 }
                 break;
             }
+            case OpCode::TAIL_CALL: {
+                int arguments_count = fetch();
+                int frame_pointer = frames.back().frame_pointer;
+                close_upvalues(stack[frame_pointer]);
+                // callee and arguments replace finished frame so call depth doesn't grow
+                std::copy(
+                    stack.begin() + (stack_index - arguments_count - 1),
+                    stack.begin() + stack_index,
+                    stack.begin() + frame_pointer
+                );
+                stack_index = frame_pointer + arguments_count + 1;
+                frames.pop_back();
+                if (auto error = call_value(stack[frame_pointer], arguments_count)) {
+                    return std::unexpected(*error);
+                }
+                // foreign functions return immediately
+                if (frames.empty()) {
+                    return pop();
+                }
+                break;
+            }
             case OpCode::RETURN: {
                 Value result = pop();
                 close_upvalues(stack[frames.back().frame_pointer]); // TODO: check
@@ -581,6 +771,16 @@ std::expected<Value, VM::RuntimeError> VM::run() {
             }
             case OpCode::CLOSURE: {
                 Function* function = reinterpret_cast<Function*>(*get_constant(fetch()).as<Object*>());
+                // closure without upvalues has no state of its own so it can be created just once
+                if (function->get_upvalue_count() == 0 && !get_current_receiver()) {
+                    Closure*& shared = shared_closures[function];
+                    if (!shared) {
+                        shared = new Closure(function);
+                        allocate(shared);
+                    }
+                    push(shared);
+                    break;
+                }
                 auto* closure = new Closure(function);
                 for (int i = 0; i < closure->get_function()->get_upvalue_count(); ++i) {
                     int is_local = fetch();
@@ -617,6 +817,16 @@ std::expected<Value, VM::RuntimeError> VM::run() {
                 push(*frames.back().closure->upvalues[slot]->location);
                 break;
             }
+            case OpCode::GET_ENCLOSING_SLOT: {
+                int slot = fetch();
+                push(stack[frames[frames.size() - 2].frame_pointer + slot]);
+                break;
+            }
+            case OpCode::SET_ENCLOSING_SLOT: {
+                int slot = fetch();
+                stack[frames[frames.size() - 2].frame_pointer + slot] = peek();
+                break;
+            }
             case OpCode::SET_UPVALUE: {
                 int slot = fetch();
                 *frames.back().closure->upvalues[slot]->location = peek();
@@ -1019,16 +1229,37 @@ std::expected<Value, VM::RuntimeError> VM::run() {
                 }
                 break;
             }
+            // operands are read directly from frame, operation itself is dispatched as usual
+            case OpCode::BINARY_SLOTS: {
+                opcode = fetch_opcode();
+                int left = fetch();
+                int right = fetch();
+                push(get_from_slot(left));
+                push(get_from_slot(right));
+                goto dispatch;
+            }
+            case OpCode::BINARY_SLOT_CONSTANT: {
+                opcode = fetch_opcode();
+                int left = fetch();
+                int constant = fetch();
+                push(get_from_slot(left));
+                push(get_constant(constant));
+                goto dispatch;
+            }
+            case OpCode::GET_SLOT_PROPERTY: {
+                // name constant operand is fetched by GET_PROPERTY itself
+                push(get_from_slot(fetch()));
+                opcode = OpCode::GET_PROPERTY;
+                goto dispatch;
+            }
             case OpCode::GET_GLOBAL: {
                 int constant_idx = fetch();
-                auto name = get_constant(constant_idx).get<std::string>();
-                push(globals[name]); // TODO: what should happen if not present?
+                push(get_global(constant_idx));
                 break;
             }
             case OpCode::SET_GLOBAL: {
                 int constant_idx = fetch();
-                auto name = get_constant(constant_idx).get<std::string>();
-                globals[name] = peek();
+                get_global(constant_idx) = peek();
                 break;
             }
             case OpCode::IMPORT: {
@@ -1088,6 +1319,8 @@ std::expected<Value, VM::RuntimeError> VM::run() {
         // std::cout << '\n';
     }
     #undef BINARY_OPERATION
+    #undef NUMBER_FAST_PATH
+    #undef INT_FAST_PATH
 }
 
 Object* VM::allocate(Object* ptr) {
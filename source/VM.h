@@ -1,5 +1,6 @@
 #ifndef VM_H
 #define VM_H
+#include <algorithm>
 #include <expected>
 #include <stdexcept>
 #include <vector>
@@ -21,6 +22,7 @@ public:
     explicit VM(GarbageCollector* gc, Function* function, SharedContext* context) : gc(gc), context(context) {
         auto* closure = new Closure(function);
         // todo: maybe start program thru call()
+        stack.resize(std::max<std::size_t>(INITIAL_STACK_SIZE, function->get_max_stack() + VM_TEMPORARIES));
         frames.emplace_back(closure, 0, 0);
         allocate(closure);
         // adopt_objects(function->get_allocated());
@@ -29,20 +31,25 @@ public:
     uint8_t fetch();
     OpCode fetch_opcode();
     uint16_t fetch_short();
+    uint32_t fetch_long();
 
-    void jump_to(uint32_t pos);
+    void jump_by(int32_t offset);
     [[nodiscard]] Value get_constant(int idx) const;
 
-    uint32_t get_jump_destination(int idx) const;
-
     Value pop();
     [[nodiscard]] Value peek(int n = 0) const;
     void push(const Value& value);
 
     Value& get_from_slot(int index);
     void set_in_slot(int index, const Value& value);
+    // cached per function, speeds up only code touching globals (top-level loops, calls of top-level functions),
+    // locals and parameters in function bodies are already plain slot accesses
+    Value& get_global(int constant_idx);
 
     std::optional<RuntimeError> call_value(const Value& value, int arguments_count);
+    std::optional<RuntimeError> reserve_stack(const Function* function);
+    // highest stack index current frame may reach according to compiled max stack depth
+    [[nodiscard]] int frame_stack_limit() const;
 
     Upvalue* capture_upvalue(int index);
 
@@ -107,8 +114,12 @@ public:
     std::expected<Value, RuntimeError> run();
 
     Object* allocate(Object* ptr);
-    std::array<Value, 256> stack;
-    bite::unordered_dense::map<std::string, Value> globals;
+    // grown only when function is called so pushes don't need to check bounds
+    std::vector<Value> stack;
+    // segmented so references to globals stay valid and can be cached by functions
+    bite::unordered_dense::segmented_map<std::string, Value> globals;
+    // closures of functions without upvalues shared by all their evaluations
+    bite::unordered_dense::map<Function*, Closure*> shared_closures;
 
     Class* number_class = nullptr;
     Class* bool_class = nullptr;
@@ -117,14 +128,23 @@ public:
     Class* string_class = nullptr;
     Class* undefined_class = nullptr;
 private:
+    // unique for every VM instance, unlike address which can be reused
+    static inline std::uint64_t next_id = 0;
+    std::uint64_t id = ++next_id;
     GarbageCollector* gc;
     std::size_t next_gc = 1024 * 1024;
     std::vector<int> block_stack;
     static constexpr std::size_t HEAP_GROWTH_FACTOR = 2;
-    // stack dynamic allocation breaks upvalues!
+    static constexpr std::size_t INITIAL_STACK_SIZE = 256;
+    static constexpr std::size_t MAX_STACK_SIZE = 1024 * 1024;
+    // values pushed by the vm itself above the compiled max stack depth:
+    // instantiation (and super constructor call) without arguments pushes the instance and the bound constructor
+    // in place of the class, negation of an instance pushes the bound method and its argument
+    static constexpr std::size_t VM_TEMPORARIES = 1;
     int stack_index = 0;
     std::vector<CallFrame> frames;
-    std::list<Upvalue*> open_upvalues;
+    // sorted from the top of the stack, linked thru Upvalue::next
+    Upvalue* open_upvalues = nullptr;
     SharedContext* context;
 };
 
@@ -0,0 +1,81 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace bite {
+    /**
+     * Bump allocator which releases all of its memory at once when destroyed.
+     * Objects placed in arena must still be destroyed, but deallocating them is free.
+     */
+    class Arena {
+    public:
+        static constexpr std::size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+        explicit Arena(const std::size_t block_size = DEFAULT_BLOCK_SIZE) : block_size(block_size) {}
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void* allocate(const std::size_t size, const std::size_t alignment) {
+            auto address = reinterpret_cast<std::uintptr_t>(cursor);
+            std::size_t padding = (alignment - address % alignment) % alignment;
+            if (cursor == nullptr || static_cast<std::size_t>(end - cursor) < padding + size) {
+                // allocations bigger than block get their own block
+                std::size_t size_of_block = std::max(block_size, size + alignment);
+                blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(size_of_block));
+                cursor = blocks.back().get();
+                end = cursor + size_of_block;
+                address = reinterpret_cast<std::uintptr_t>(cursor);
+                padding = (alignment - address % alignment) % alignment;
+            }
+            std::byte* result = cursor + padding;
+            cursor = result + size;
+            ++allocations;
+            return result;
+        }
+
+        // number of allocations served so far, for syntax trees it equals number of nodes
+        [[nodiscard]] std::size_t allocation_count() const {
+            return allocations;
+        }
+
+        /**
+         * Makes arena current for allocations in this thread until the scope ends.
+         * Used by types which allocate thru the arena implicitly (e.g. ast nodes).
+         */
+        class Scope {
+        public:
+            explicit Scope(Arena* arena) : previous(std::exchange(current_arena, arena)) {}
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+            ~Scope() {
+                current_arena = previous;
+            }
+
+        private:
+            Arena* previous;
+        };
+
+        static Arena* current() {
+            return current_arena;
+        }
+
+    private:
+        static inline thread_local Arena* current_arena = nullptr;
+
+        std::size_t block_size;
+        std::vector<std::unique_ptr<std::byte[]>> blocks;
+        std::byte* cursor = nullptr;
+        std::byte* end = nullptr;
+        std::size_t allocations = 0;
+    };
+} // namespace bite
+
+#endif //ARENA_H
@@ -0,0 +1,105 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BITE_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bite {
+    /**
+     * Read-only view of whole file contents.
+     * Uses shared memory mapping where available so the same file opened by many processes shares physical pages,
+     * otherwise falls back to reading file into memory.
+     */
+    class mapped_file {
+    public:
+        static std::optional<mapped_file> open(const std::filesystem::path& path) {
+            mapped_file file;
+            #ifdef BITE_HAS_MMAP
+            int descriptor = ::open(path.c_str(), O_RDONLY);
+            if (descriptor == -1) {
+                return {};
+            }
+            struct stat info {};
+            if (::fstat(descriptor, &info) == -1) {
+                ::close(descriptor);
+                return {};
+            }
+            if (info.st_size > 0) {
+                void* address = ::mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+                if (address == MAP_FAILED) {
+                    ::close(descriptor);
+                    return {};
+                }
+                file.m_data = { static_cast<const unsigned char*>(address), static_cast<std::size_t>(info.st_size) };
+                file.m_is_mapped = true;
+            }
+            // mapping stays valid after descriptor is closed
+            ::close(descriptor);
+            #else
+            std::ifstream stream(path, std::ios::binary);
+            if (!stream) {
+                return {};
+            }
+            file.m_buffer.assign(std::istreambuf_iterator<char>(stream), {});
+            file.m_data = { reinterpret_cast<const unsigned char*>(file.m_buffer.data()), file.m_buffer.size() };
+            #endif
+            return file;
+        }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        mapped_file(mapped_file&& other) noexcept : m_data(std::exchange(other.m_data, {})),
+                                                    m_is_mapped(std::exchange(other.m_is_mapped, false)),
+                                                    m_buffer(std::move(other.m_buffer)) {}
+
+        mapped_file& operator=(mapped_file&& other) noexcept {
+            if (this != &other) {
+                unmap();
+                m_data = std::exchange(other.m_data, {});
+                m_is_mapped = std::exchange(other.m_is_mapped, false);
+                m_buffer = std::move(other.m_buffer);
+            }
+            return *this;
+        }
+
+        ~mapped_file() {
+            unmap();
+        }
+
+        [[nodiscard]] std::span<const unsigned char> data() const {
+            return m_data;
+        }
+
+    private:
+        mapped_file() = default;
+
+        void unmap() {
+            #ifdef BITE_HAS_MMAP
+            if (m_is_mapped) {
+                ::munmap(const_cast<unsigned char*>(m_data.data()), m_data.size());
+            }
+            #endif
+            m_is_mapped = false;
+        }
+
+        std::span<const unsigned char> m_data;
+        bool m_is_mapped = false;
+        // fallback storage when memory mapping is not available
+        std::vector<char> m_buffer;
+    };
+} // namespace bite
+
+#endif //MAPPED_FILE_H
@@ -0,0 +1,214 @@
+#ifndef SCAN_H
+#define SCAN_H
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__AVX2__)
+#define BITE_SCAN_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define BITE_SCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "chars.h"
+
+// Scanners used by lexer for its hot loops. Each one returns position of the first character at or after given
+// position which doesn't belong to the scanned run (or size of the source).
+// Source is checked in blocks of 32 (AVX2) or 16 (SSE2) bytes, the remainder and other targets use scalar loop.
+namespace bite::scan {
+    namespace detail {
+        #if defined(BITE_SCAN_AVX2)
+        using block = __m256i;
+        constexpr std::size_t BLOCK_SIZE = 32;
+
+        inline block load(const char* data) {
+            return _mm256_loadu_si256(reinterpret_cast<const block*>(data));
+        }
+
+        inline block splat(const char c) {
+            return _mm256_set1_epi8(c);
+        }
+
+        inline block equal(const block a, const char c) {
+            return _mm256_cmpeq_epi8(a, splat(c));
+        }
+
+        // bytes are compared as signed so characters outside of ascii are never in range
+        inline block in_range(const block a, const char low, const char high) {
+            return _mm256_and_si256(
+                _mm256_cmpgt_epi8(a, splat(static_cast<char>(low - 1))),
+                _mm256_cmpgt_epi8(splat(static_cast<char>(high + 1)), a)
+            );
+        }
+
+        inline block either(const block a, const block b) {
+            return _mm256_or_si256(a, b);
+        }
+
+        inline block with_bits(const block a, const char bits) {
+            return _mm256_or_si256(a, splat(bits));
+        }
+
+        inline std::uint32_t mask(const block a) {
+            return static_cast<std::uint32_t>(_mm256_movemask_epi8(a));
+        }
+        #elif defined(BITE_SCAN_SSE2)
+        using block = __m128i;
+        constexpr std::size_t BLOCK_SIZE = 16;
+
+        inline block load(const char* data) {
+            return _mm_loadu_si128(reinterpret_cast<const block*>(data));
+        }
+
+        inline block splat(const char c) {
+            return _mm_set1_epi8(c);
+        }
+
+        inline block equal(const block a, const char c) {
+            return _mm_cmpeq_epi8(a, splat(c));
+        }
+
+        // bytes are compared as signed so characters outside of ascii are never in range
+        inline block in_range(const block a, const char low, const char high) {
+            return _mm_and_si128(
+                _mm_cmpgt_epi8(a, splat(static_cast<char>(low - 1))),
+                _mm_cmplt_epi8(a, splat(static_cast<char>(high + 1)))
+            );
+        }
+
+        inline block either(const block a, const block b) {
+            return _mm_or_si128(a, b);
+        }
+
+        inline block with_bits(const block a, const char bits) {
+            return _mm_or_si128(a, splat(bits));
+        }
+
+        inline std::uint32_t mask(const block a) {
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(a));
+        }
+        #endif
+
+        #if defined(BITE_SCAN_AVX2) || defined(BITE_SCAN_SSE2)
+        constexpr std::uint32_t FULL_MASK = BLOCK_SIZE == 32 ? 0xffffffffU : 0xffffU;
+        #endif
+
+        /**
+         * @param is_stop scalar predicate for characters ending the run
+         * @param stop_mask returns bit mask of characters ending the run in the block
+         */
+        template <typename Scalar, typename Vector>
+        std::size_t find(
+            const std::string_view source,
+            std::size_t position,
+            const Scalar& is_stop,
+            [[maybe_unused]] const Vector& stop_mask
+        ) {
+            #if defined(BITE_SCAN_AVX2) || defined(BITE_SCAN_SSE2)
+            while (position + BLOCK_SIZE <= source.size()) {
+                if (std::uint32_t stops = stop_mask(load(source.data() + position))) {
+                    return position + std::countr_zero(stops);
+                }
+                position += BLOCK_SIZE;
+            }
+            #endif
+            while (position < source.size() && !is_stop(source[position])) {
+                ++position;
+            }
+            return position;
+        }
+    } // namespace detail
+
+    inline std::size_t skip_whitespace(const std::string_view source, const std::size_t position) {
+        return detail::find(
+            source,
+            position,
+            [](const char c) { return !is_space(c); },
+            [](const auto block) {
+                #if defined(BITE_SCAN_AVX2) || defined(BITE_SCAN_SSE2)
+                // '\t', '\n', '\v', '\f' and '\r' are consecutive
+                auto spaces = detail::either(detail::equal(block, ' '), detail::in_range(block, '\t', '\r'));
+                return ~detail::mask(spaces) & detail::FULL_MASK;
+                #else
+                return block;
+                #endif
+            }
+        );
+    }
+
+    inline std::size_t skip_identifier(const std::string_view source, const std::size_t position) {
+        return detail::find(
+            source,
+            position,
+            [](const char c) { return !is_identifier(c); },
+            [](const auto block) {
+                #if defined(BITE_SCAN_AVX2) || defined(BITE_SCAN_SSE2)
+                // setting 0x20 bit lowercases letters without making any other character a letter
+                auto letters = detail::in_range(detail::with_bits(block, 0x20), 'a', 'z');
+                auto identifier = detail::either(
+                    letters,
+                    detail::either(detail::in_range(block, '0', '9'), detail::equal(block, '_'))
+                );
+                return ~detail::mask(identifier) & detail::FULL_MASK;
+                #else
+                return block;
+                #endif
+            }
+        );
+    }
+
+    inline std::size_t find_line_end(const std::string_view source, const std::size_t position) {
+        return detail::find(
+            source,
+            position,
+            [](const char c) { return c == '\n'; },
+            [](const auto block) {
+                #if defined(BITE_SCAN_AVX2) || defined(BITE_SCAN_SSE2)
+                return detail::mask(detail::equal(block, '\n'));
+                #else
+                return block;
+                #endif
+            }
+        );
+    }
+
+    // characters with special meaning inside of string literal: end of string, escape and interpolation
+    inline std::size_t find_string_special(const std::string_view source, const std::size_t position) {
+        return detail::find(
+            source,
+            position,
+            [](const char c) { return c == '"' || c == '\\' || c == '$'; },
+            [](const auto block) {
+                #if defined(BITE_SCAN_AVX2) || defined(BITE_SCAN_SSE2)
+                auto special = detail::either(
+                    detail::equal(block, '"'),
+                    detail::either(detail::equal(block, '\\'), detail::equal(block, '$'))
+                );
+                return detail::mask(special);
+                #else
+                return block;
+                #endif
+            }
+        );
+    }
+
+    inline std::size_t skip_ascii(const std::string_view source, const std::size_t position) {
+        return detail::find(
+            source,
+            position,
+            [](const char c) { return static_cast<unsigned char>(c) >= 0x80; },
+            [](const auto block) {
+                #if defined(BITE_SCAN_AVX2) || defined(BITE_SCAN_SSE2)
+                return detail::mask(block); // highest bit of every byte
+                #else
+                return block;
+                #endif
+            }
+        );
+    }
+} // namespace bite::scan
+
+#endif //SCAN_H
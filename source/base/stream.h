@@ -1,7 +1,11 @@
 #ifndef STREAM_H
 #define STREAM_H
 
-#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "mapped_file.h"
 
 // === Common abstraction for streams and file stream
 namespace bite {
@@ -53,21 +57,34 @@ namespace bite {
         std::size_t m_position = 0;
     };
 
-    // TODO: check errors!
-    class file_input_stream : public input_stream_base<char> {
+    /**
+     * Whole source file in one contiguous buffer (memory mapped where available),
+     * so lexemes can be referenced as slices of the source instead of being copied character by character.
+     */
+    class source_input_stream : public input_stream_base<char> {
     public:
-        [[nodiscard]] explicit file_input_stream(const std::string& path) : path(path),
-                                                                            file(path) {
-            advance();
-            m_position = 0;
+        [[nodiscard]] explicit source_input_stream(const std::string& path) : path(path),
+                                                                              file(mapped_file::open(path)) {
+            if (file) {
+                auto data = file->data();
+                contents = { reinterpret_cast<const char*>(data.data()), data.size() };
+            }
+            m_next = at(0);
+        }
+
+        // source which is not read from the file (f.e. editor buffer), text must outlive the stream
+        [[nodiscard]] source_input_stream(const std::string& path, const std::string_view text) : path(path),
+            contents(text) {
+            m_next = at(0);
         }
 
         [[nodiscard]] bool ended() const {
-            return file.eof();
+            return m_position >= contents.size();
         }
 
-        [[nodiscard]] char get(std::size_t /*unused*/) {
-            return static_cast<char>(file.get()); // safe?
+        // returns character following the one at given position
+        [[nodiscard]] char get(const std::size_t position) const {
+            return at(position + 1);
         }
 
         [[nodiscard]] char default_value() const {
@@ -78,9 +95,33 @@ namespace bite {
             return path;
         }
 
+        [[nodiscard]] std::string_view source() const {
+            return contents;
+        }
+
+        [[nodiscard]] std::string_view slice(const std::size_t start, const std::size_t end) const {
+            return contents.substr(start, end - start);
+        }
+
+        // consumes everything before given position
+        void advance_to(const std::size_t position) {
+            if (position == m_position) {
+                return;
+            }
+            m_position = position;
+            m_current = at(position - 1);
+            m_next = at(position);
+        }
+
     private:
+        [[nodiscard]] char at(const std::size_t position) const {
+            return position < contents.size() ? contents[position] : '\0';
+        }
+
         std::string path;
-        std::ifstream file;
+        // mapping and its fallback buffer don't move in memory when stream is moved so view stays valid
+        std::optional<mapped_file> file;
+        std::string_view contents;
     };
 }  // namespace bite
 #endif //STREAM_H
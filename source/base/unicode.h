@@ -1,5 +1,8 @@
 #ifndef UNICODE_H
 #define UNICODE_H
+#include <string_view>
+
+#include "scan.h"
 
 namespace bite::unicode {
     // TODO: refactor
@@ -34,6 +37,47 @@ namespace bite::unicode {
 
         return true;
     }
+
+    // rejects overlong encodings, surrogates and codepoints above U+10FFFF
+    inline bool is_valid_utf8(const std::string_view string) {
+        std::size_t position = 0;
+        while ((position = scan::skip_ascii(string, position)) < string.size()) {
+            auto lead = static_cast<unsigned char>(string[position]);
+            std::size_t length;
+            char32_t codepoint;
+            char32_t minimum;
+            if ((lead & 0xE0) == 0xC0) {
+                length = 2;
+                codepoint = lead & 0x1F;
+                minimum = 0x80;
+            } else if ((lead & 0xF0) == 0xE0) {
+                length = 3;
+                codepoint = lead & 0x0F;
+                minimum = 0x800;
+            } else if ((lead & 0xF8) == 0xF0) {
+                length = 4;
+                codepoint = lead & 0x07;
+                minimum = 0x10000;
+            } else {
+                return false;
+            }
+            if (string.size() - position < length) {
+                return false;
+            }
+            for (std::size_t i = 1; i < length; ++i) {
+                auto continuation = static_cast<unsigned char>(string[position + i]);
+                if ((continuation & 0xC0) != 0x80) {
+                    return false;
+                }
+                codepoint = codepoint << 6 | (continuation & 0x3F);
+            }
+            if (codepoint < minimum || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+                return false;
+            }
+            position += length;
+        }
+        return true;
+    }
 }
 
 
@@ -60,13 +60,13 @@ void apply_core(VM* vm, SharedContext* context) {
     auto* int_floor_div = new ForeginFunctionObject(
         new ForeignFunction {
             .arity = 1,
-            .name = context->intern("floor_div"),
+            .name = context->intern("floor_divide"),
             .function = [](FunctionContext ctx) {
                 return ctx.get_instance().get<bite_int>() / ctx.get_arg(0).get<bite_int>();
             }
         }
     );
-    int_class->methods["floor_div"] = ClassValue { .value = int_floor_div, .attributes = {}, .is_computed = false };
+    int_class->methods["floor_divide"] = ClassValue { .value = int_floor_div, .attributes = {}, .is_computed = false };
 
     auto* int_modulo = new ForeginFunctionObject(
         new ForeignFunction {
@@ -132,7 +132,7 @@ void apply_core(VM* vm, SharedContext* context) {
             }
         }
     );
-    int_class->methods["int_less_equal"] = ClassValue {
+    int_class->methods["less_equal"] = ClassValue {
             .value = int_less_equal,
             .attributes = {},
             .is_computed = false
@@ -215,7 +215,7 @@ void apply_core(VM* vm, SharedContext* context) {
             .arity = 1,
             .name = context->intern("binary_xor"),
             .function = [](FunctionContext ctx) {
-                return ctx.get_instance().get<bite_int>() + ctx.get_arg(0).get<bite_int>();
+                return ctx.get_instance().get<bite_int>() ^ ctx.get_arg(0).get<bite_int>();
             }
         }
     );
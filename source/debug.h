@@ -18,6 +18,8 @@ private:
     void class_inst(const std::string& name);
     void arg_inst(const std::string& name);
     void jump_inst(const std::string& name);
+    void long_jump_inst(const std::string& name);
+    void slots_inst(const std::string& name, bool is_right_constant);
     int offset = 0;
     Function& function;
 };
@@ -51,10 +53,32 @@ inline void Disassembler::arg_inst(const std::string& name) {
 }
 
 inline void Disassembler::jump_inst(const std::string& name) {
-    int x = function.get_program().get_at(offset++);
-    std::cout << offset - 2 << ": " << name << " to: " << x << ' ' << function.get_jump_destination(x) << '\n';
+    int high = function.get_program().get_at(offset++);
+    int low = function.get_program().get_at(offset++);
+    auto jump_offset = static_cast<int16_t>(high << 8 | low);
+    std::cout << offset - 3 << ": " << name << " offset: " << jump_offset << " to: " << offset + jump_offset << '\n';
 }
 
+inline void Disassembler::long_jump_inst(const std::string& name) {
+    std::uint32_t encoded = 0;
+    for (int i = 0; i < 4; ++i) {
+        encoded = encoded << 8 | function.get_program().get_at(offset++);
+    }
+    auto jump_offset = static_cast<int32_t>(encoded);
+    std::cout << offset - 5 << ": " << name << " offset: " << jump_offset << " to: " << offset + jump_offset << '\n';
+}
+
+inline void Disassembler::slots_inst(const std::string& name, bool is_right_constant) {
+    int op = function.get_program().get_at(offset++);
+    int left = function.get_program().get_at(offset++);
+    int right = function.get_program().get_at(offset++);
+    std::cout << offset - 4 << ": " << name << " op: " << op << " slot: " << left;
+    if (is_right_constant) {
+        std::cout << " constant: " << right << ' ' << function.get_constant(right).to_string() << '\n';
+    } else {
+        std::cout << " slot: " << right << '\n';
+    }
+}
 
 inline void Disassembler::disassemble(const std::string& name) {
     std::cout << "--- " << name << " ---\n";
@@ -123,6 +147,12 @@ inline void Disassembler::disassemble(const std::string& name) {
                 break;
             case OpCode::CALL: arg_inst("CALL");
                 break;
+            case OpCode::TAIL_CALL: arg_inst("TAIL_CALL");
+                break;
+            case OpCode::GET_ENCLOSING_SLOT: arg_inst("GET_ENCLOSING_SLOT");
+                break;
+            case OpCode::SET_ENCLOSING_SLOT: arg_inst("SET_ENCLOSING_SLOT");
+                break;
             case OpCode::RETURN: simple_opcode("RETURN");
                 break;
             case OpCode::CLOSURE: {
@@ -247,6 +277,29 @@ inline void Disassembler::disassemble(const std::string& name) {
                 jump_inst("JUMP_IF_NOT_UNDEFINED");
                 break;
             }
+            case OpCode::POP_JUMP_IF_FALSE: {
+                jump_inst("POP_JUMP_IF_FALSE");
+                break;
+            }
+            case OpCode::JUMP_LONG: {
+                long_jump_inst("JUMP_LONG");
+                break;
+            }
+            case OpCode::GET_SLOT_PROPERTY: {
+                int slot = program.get_at(offset++);
+                int constant = program.get_at(offset++);
+                std::cout << offset - 3 << ": GET_SLOT_PROPERTY slot: " << slot << " constant: " << constant << ' '
+                    << function.get_constant(constant).to_string() << '\n';
+                break;
+            }
+            case OpCode::BINARY_SLOTS: {
+                slots_inst("BINARY_SLOTS", false);
+                break;
+            }
+            case OpCode::BINARY_SLOT_CONSTANT: {
+                slots_inst("BINARY_SLOT_CONSTANT", true);
+                break;
+            }
         }
     }
 }
@@ -1,6 +1,8 @@
 #include <chrono>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <string_view>
 #include "Compiler.h"
 #include "shared/SharedContext.h"
 // TODO: cyclic imports
@@ -9,11 +11,19 @@
 // TODO: investigate fun in class infinite loop?
 int main(int argc, char** argv) {
     // TODO error handling
-    if (argc != 2) {
-        std::cerr << "Usage: ./bite [path to bite file]\n";
+    bool is_linking = argc == 4 && std::string_view(argv[1]) == "--link";
+    bool is_embedding_image = argc == 4 && std::string_view(argv[1]) == "--embed-image";
+    if (argc != 2 && !is_linking && !is_embedding_image) {
+        std::cerr << "Usage: ./bite [path to bite file or image]\n";
+        std::cerr << "       ./bite --link [output image path] [path to bite file]\n";
+        std::cerr << "       ./bite --embed-image [output c++ source path] [path to bite file]\n";
+        std::cerr << "         (embeds linked image bytes, writes header with the same name next to the source)\n";
         return -1;
     }
     SharedContext context { bite::Logger(std::cout, true) };
+    if (const char* cache_directory = std::getenv("BITE_CACHE_DIR")) {
+        context.enable_bytecode_cache(cache_directory);
+    }
 
     auto os_module = std::make_unique<ForeignModule>();
     auto print_symbol = context.intern("print");
@@ -30,7 +40,15 @@ int main(int argc, char** argv) {
         };
 
     context.add_module(context.intern("os"), std::move(os_module));
-    FileModule* main_module = context.compile(argv[1]);
+    if (is_linking) {
+        return context.link_image(argv[3], argv[2]) ? 0 : -1;
+    }
+    if (is_embedding_image) {
+        return context.embed_image(argv[3], argv[2]) ? 0 : -1;
+    }
+    FileModule* main_module = BytecodeImage::is_image(argv[1])
+                                  ? context.load_image(argv[1])
+                                  : context.compile(argv[1]);
     if (!main_module) {
         return -1;
     }
@@ -4,9 +4,17 @@
 
 #include "../base/chars.h"
 #include "../base/perfect_map.h"
+#include "../base/scan.h"
 #include "../base/unicode.h"
 #include "../shared/SharedContext.h"
 
+Lexer::Lexer(bite::source_input_stream&& stream, SharedContext* context) : context(context),
+                                                                         stream(std::move(stream)) {
+    file_id = context->files.id_of(context->intern(this->stream.get_filepath()));
+    empty_string = context->intern("");
+    state.emplace();
+}
+
 std::expected<Token, bite::Diagnostic> Lexer::next_token() {
     skip_whitespace();
     start_pos = stream.position();
@@ -112,7 +120,6 @@ std::expected<Token, bite::Diagnostic> Lexer::next_token() {
         case '"': return string();
         case '@': return label();
         default: {
-            buffer.push_back(c);
             if (is_digit(c)) {
                 // TODO: number literals should be able to start with dot
                 return integer_or_number();
@@ -128,39 +135,44 @@ std::expected<Token, bite::Diagnostic> Lexer::next_token() {
 
 void Lexer::skip_whitespace() {
     while (true) {
-        if (is_space(stream.next()) || stream.next() == '\n') {
-            stream.advance();
-        } else if (stream.next() == '#') {
-            while (!stream.ended() && !stream.match('\n')) {
-                stream.advance();
-            }
-        } else {
+        stream.advance_to(bite::scan::skip_whitespace(stream.source(), stream.position()));
+        if (stream.next() != '#') {
             break;
         }
+        // comment continues until the end of line
+        stream.advance_to(bite::scan::find_line_end(stream.source(), stream.position()));
+        stream.match('\n');
     }
 }
 
 void Lexer::consume_identifier() {
-    while (is_identifier(stream.next())) {
-        buffer.push_back(stream.advance());
-    }
+    stream.advance_to(bite::scan::skip_identifier(stream.source(), stream.position()));
 }
 
+// tokens without string value (operators and punctuation)
 Token Lexer::make_token(const Token::Type type) {
-    // TODO: empty buffer optimization?
-    const StringTable::Handle string = context->intern(buffer);
-    buffer.clear();
     return {
             .type = type,
             .span = bite::SourceSpan {
-                .start_offset = static_cast<int64_t>(start_pos),
-                .end_offset = static_cast<int64_t>(stream.position()),
-                .file_path = context->intern(stream.get_filepath())
+                .start_offset = static_cast<std::uint32_t>(start_pos),
+                .end_offset = static_cast<std::uint32_t>(stream.position()),
+                .file_id = file_id
             },
-            .string = string
+            .string = empty_string
         };
 }
 
+Token Lexer::make_token(const Token::Type type, const std::string_view string) {
+    Token token = make_token(type);
+    token.string = context->intern(string);
+    return token;
+}
+
+// source of the token which is being lexed
+std::string_view Lexer::lexeme() const {
+    return stream.slice(start_pos, stream.position());
+}
+
 std::unexpected<bite::Diagnostic> Lexer::make_error(const std::string& reason, const std::string& inline_message) {
     return std::unexpected(
         bite::Diagnostic {
@@ -169,9 +181,9 @@ std::unexpected<bite::Diagnostic> Lexer::make_error(const std::string& reason, c
             .inline_hints = {
                 bite::InlineHint {
                     .location = bite::SourceSpan {
-                        .start_offset = static_cast<int64_t>(start_pos),
-                        .end_offset = static_cast<int64_t>(stream.position()),
-                        .file_path = context->intern(get_filepath()),
+                        .start_offset = static_cast<std::uint32_t>(start_pos),
+                        .end_offset = static_cast<std::uint32_t>(stream.position()),
+                        .file_id = file_id,
                     },
                     .message = inline_message,
                     .level = bite::DiagnosticLevel::ERROR,
@@ -224,10 +236,10 @@ constexpr static perfect_map<Token::Type, 33> identifiers(
 Token Lexer::keyword_or_identifier() {
     consume_identifier();
 
-    if (const std::optional<Token::Type> type = identifiers[buffer]) {
-        return make_token(*type);
+    if (const std::optional<Token::Type> type = identifiers[lexeme()]) {
+        return make_token(*type, lexeme());
     }
-    return make_token(Token::Type::IDENTIFIER);
+    return make_token(Token::Type::IDENTIFIER, lexeme());
 }
 
 std::optional<std::unexpected<bite::Diagnostic>> Lexer::consume_unicode_scalar() {
@@ -254,6 +266,11 @@ std::optional<std::unexpected<bite::Diagnostic>> Lexer::consume_unicode_scalar()
 
 std::expected<Token, bite::Diagnostic> Lexer::string() {
     // TODO: better error recovery. should not abort immediately
+    // strings without escape sequences are sliced directly from the source,
+    // otherwise contents are decoded into the buffer from the first escape sequence onwards
+    const std::size_t contents_start = stream.position();
+    bool is_decoded = false;
+    buffer.clear();
     bool escape_next = false;
     while (!stream.ended() && (escape_next || stream.next() != '"')) {
         if (escape_next) {
@@ -288,7 +305,9 @@ std::expected<Token, bite::Diagnostic> Lexer::string() {
                     break;
                 }
                 case 'u': {
-                    consume_unicode_scalar();
+                    if (auto error = consume_unicode_scalar()) {
+                        return *error;
+                    }
                     break;
                 }
                 default: {
@@ -297,52 +316,69 @@ std::expected<Token, bite::Diagnostic> Lexer::string() {
             }
             escape_next = false;
         } else {
+            // plain characters are consumed in runs up to the next special character
+            std::size_t run_start = stream.position();
+            std::size_t run_end = bite::scan::find_string_special(stream.source(), run_start);
+            if (run_end != run_start) {
+                auto run = stream.slice(run_start, run_end);
+                if (!bite::unicode::is_valid_utf8(run)) {
+                    return make_error("invalid UTF-8 in string literal", "here");
+                }
+                if (is_decoded) {
+                    buffer += run;
+                }
+                stream.advance_to(run_end);
+                continue;
+            }
             if (stream.next() == '\\') {
+                if (!is_decoded) {
+                    buffer = stream.slice(contents_start, stream.position());
+                    is_decoded = true;
+                }
                 stream.advance();
                 escape_next = true;
                 continue;
             }
             // String interpolation, see header file for more info
             if (stream.next() == '$') {
+                auto contents = is_decoded ? std::string_view(buffer) : stream.slice(contents_start, stream.position());
                 stream.advance();
                 if (stream.next() == '{') {
                     stream.advance();
                     state.emplace();
-                    return make_token(Token::Type::STRING_PART);
+                    return make_token(Token::Type::STRING_PART, contents);
                 } else {
                     consume_identifer_on_next = true;
-                    return make_token(Token::Type::STRING_PART);
+                    return make_token(Token::Type::STRING_PART, contents);
                 }
             }
-
-            buffer.push_back(stream.advance());
         }
     }
 
+    auto contents = is_decoded ? std::string_view(buffer) : stream.slice(contents_start, stream.position());
     if (!stream.match('"')) {
         return make_error("unterminated string", "expected \" after this");
     }
 
-    return make_token(Token::Type::STRING);
+    return make_token(Token::Type::STRING, contents);
 }
 
 Token Lexer::integer_or_number() {
     while (is_number_literal_char(stream.next())) {
-        buffer.push_back(stream.advance());
+        stream.advance();
     }
     // if no dot exists separator it is a integer
     if (!stream.match('.')) {
-        return make_token(Token::Type::INTEGER);
+        return make_token(Token::Type::INTEGER, lexeme());
     }
     // otherwise it is a fraction
     while (is_number_literal_char(stream.next())) {
-        buffer.push_back(stream.advance());
+        stream.advance();
     }
-    return make_token(Token::Type::NUMBER);
+    return make_token(Token::Type::NUMBER, lexeme());
 }
 
 Token Lexer::label() {
-    buffer.push_back(stream.current()); // get @
     consume_identifier();
-    return make_token(Token::Type::LABEL);
+    return make_token(Token::Type::LABEL, lexeme()); // including @
 }
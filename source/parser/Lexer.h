@@ -2,6 +2,7 @@
 #define LEXER_H
 #include <expected>
 #include <stack>
+#include <string_view>
 #include <vector>
 
 #include "Token.h"
@@ -19,10 +20,7 @@ public:
         std::string message;
     };
 
-    explicit Lexer(bite::file_input_stream&& stream, SharedContext* context) : context(context),
-                                                                               stream(std::move(stream)) {
-        state.emplace();
-    };
+    explicit Lexer(bite::source_input_stream&& stream, SharedContext* context);
 
     std::expected<Token, bite::Diagnostic> next_token();
 
@@ -35,6 +33,8 @@ private:
     void consume_identifier();
 
     [[nodiscard]] Token make_token(Token::Type type);
+    [[nodiscard]] Token make_token(Token::Type type, std::string_view string);
+    [[nodiscard]] std::string_view lexeme() const;
     [[nodiscard]] std::unexpected<bite::Diagnostic> make_error(
         const std::string& reason,
         const std::string& inline_message = ""
@@ -75,9 +75,13 @@ private:
     bool continue_string_on_next = false;
 
     std::size_t start_pos = 0;
+    // decoded contents of string literal with escape sequences, other lexemes are slices of the source
     std::string buffer;
     SharedContext* context;
-    bite::file_input_stream stream;
+    bite::source_input_stream stream;
+    // interned once as they are shared by all tokens
+    FileTable::Id file_id;
+    StringTable::Handle empty_string;
 };
 
 #endif //LEXER_H
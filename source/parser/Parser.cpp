@@ -13,7 +13,7 @@ void Parser::error(const Token& token, const std::string& message, const std::st
     }
     panic_mode = true;
     m_has_errors = true;
-    context->diagnostics.add(
+    diagnostics.add(
         bite::Diagnostic {
             .level = bite::DiagnosticLevel::ERROR,
             .message = message,
@@ -30,7 +30,7 @@ void Parser::error(const Token& token, const std::string& message, const std::st
 
 void Parser::warning(const Token& token, const std::string& message, const std::string& inline_message) {
     // TODO: temporary
-    context->diagnostics.add(
+    diagnostics.add(
         bite::Diagnostic {
             .level = bite::DiagnosticLevel::ERROR,
             .message = message,
@@ -79,7 +79,7 @@ Token Parser::advance() {
             next = *token;
             break;
         } else {
-            context->diagnostics.add(token.error());
+            diagnostics.add(token.error());
         }
     }
     return current;
@@ -183,12 +183,15 @@ std::unique_ptr<ModuleStmt> Parser::module_stmt() {
 }
 
 Ast Parser::parse() {
+    // nodes are mostly allocated and never freed during parsing so bump allocation avoids most of malloc cost
+    auto arena = std::make_unique<bite::Arena>();
+    bite::Arena::Scope arena_scope(arena.get());
     advance(); // populate next
     std::vector<std::unique_ptr<Stmt>> stmts;
     while (!match(Token::Type::END)) {
         stmts.emplace_back(statement_or_expression());
     }
-    return Ast(std::move(stmts));
+    return Ast(std::move(arena), std::move(stmts));
 }
 
 std::unique_ptr<Stmt> Parser::statement_or_expression() {
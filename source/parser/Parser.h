@@ -24,11 +24,16 @@ public:
         return m_has_errors;
     }
 
+    // parser collects diagnostics by itself so many files can be parsed concurrently
+    [[nodiscard]] bite::DiagnosticManager& get_diagnostics() {
+        return diagnostics;
+    }
+
     std::unique_ptr<Stmt> import_stmt();
     std::unique_ptr<ModuleStmt> module_stmt();
 
     // ReSharper disable once CppPossiblyUninitializedMember
-    explicit Parser(bite::file_input_stream&& stream, SharedContext* context) : lexer(std::move(stream), context),
+    explicit Parser(bite::source_input_stream&& stream, SharedContext* context) : lexer(std::move(stream), context),
         context(context) {}
 
     Ast parse();
@@ -44,14 +49,13 @@ private:
 
     bite::SourceSpan make_span() {
         BITE_ASSERT(!span_stack.empty());
-        BITE_ASSERT(span_stack.back().start_offset != -1);
-        BITE_ASSERT(span_stack.back().end_offset != -1);
+        BITE_ASSERT(span_stack.back().start_offset <= span_stack.back().end_offset);
         return span_stack.back();
     }
 
     // TODO: remove unsafe
     bite::SourceSpan no_span() {
-        return bite::SourceSpan { .start_offset = 0, .end_offset = 0, .file_path = nullptr };
+        return bite::SourceSpan { .start_offset = 0, .end_offset = 0, .file_id = FileTable::NO_FILE };
     }
 
     auto with_source_span(const auto& fn) {
@@ -172,6 +176,7 @@ private:
     Token next;
     Lexer lexer;
     SharedContext* context;
+    bite::DiagnosticManager diagnostics;
     Ast ast;
 };
 
@@ -0,0 +1,124 @@
+#include "BytecodeCache.h"
+
+#include <format>
+#include <fstream>
+#include <random>
+
+#include "BytecodeFormat.h"
+#include "../base/hash.h"
+
+// Entry layout:
+// magic | format version | source hash | dependencies | function table (main function is the last one)
+
+namespace {
+    constexpr std::string_view MAGIC = "BITC";
+
+    std::optional<std::string> read_file(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return {};
+        }
+        return std::string(std::istreambuf_iterator<char>(file), {});
+    }
+} // namespace
+
+std::optional<BytecodeCache::Entry> BytecodeCache::load(
+    const std::string& source_path,
+    const std::uint64_t source_hash
+) const {
+    auto contents = read_file(entry_path(source_path));
+    if (!contents) {
+        return {};
+    }
+    BytecodeReader reader(*contents);
+    if (!reader.match(MAGIC) || reader.read<std::uint32_t>() != BYTECODE_FORMAT_VERSION || reader.read<std::uint64_t>()
+        != source_hash) {
+        return {};
+    }
+
+    // entry is stale when any of imported modules changed as its analysis could be different now
+    auto dependencies_count = reader.read<std::uint32_t>();
+    if (!dependencies_count) {
+        return {};
+    }
+    std::vector<Dependency> dependencies;
+    for (std::uint32_t i = 0; i < *dependencies_count; ++i) {
+        auto path = reader.read_string();
+        auto hash = reader.read<std::uint64_t>();
+        if (!path || !hash || hash_file(*path) != *hash) {
+            return {};
+        }
+        dependencies.emplace_back(std::move(*path), *hash);
+    }
+
+    auto functions = reader.read_function_table();
+    if (!functions) {
+        return {};
+    }
+    if (functions->empty() || !reader.at_end()) {
+        for (auto* function : *functions) {
+            delete function;
+        }
+        return {};
+    }
+    Function* main = functions->back();
+    return Entry { .main = main, .functions = std::move(*functions), .dependencies = std::move(dependencies) };
+}
+
+bool BytecodeCache::store(
+    const std::string& source_path,
+    const std::uint64_t source_hash,
+    Function* main,
+    const std::vector<Dependency>& dependencies
+) const {
+    BytecodeWriter writer;
+    writer.buffer += MAGIC;
+    writer.write(BYTECODE_FORMAT_VERSION);
+    writer.write(source_hash);
+    writer.write<std::uint32_t>(dependencies.size());
+    for (const auto& [path, hash] : dependencies) {
+        writer.write_string(path);
+        writer.write(hash);
+    }
+    if (!writer.collect(main)) {
+        return false;
+    }
+    writer.write_function_table();
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        return false;
+    }
+    // many processes may race for the same entry so write it under unique name and atomically rename it
+    auto path = entry_path(source_path);
+    auto temporary_path = path;
+    temporary_path += std::format(".{:08x}.tmp", std::random_device {}());
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(writer.buffer.data(), writer.buffer.size())) {
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary_path, path, error);
+    if (error) {
+        std::filesystem::remove(temporary_path, error);
+        return false;
+    }
+    return true;
+}
+
+std::optional<std::uint64_t> BytecodeCache::hash_file(const std::string& path) {
+    auto contents = read_file(path);
+    if (!contents) {
+        return {};
+    }
+    return bite::rapidhash::hash(contents->data(), contents->size());
+}
+
+std::filesystem::path BytecodeCache::entry_path(const std::string& source_path) const {
+    std::error_code error;
+    auto absolute = std::filesystem::absolute(source_path, error);
+    std::string key = error ? source_path : absolute.lexically_normal().string();
+    return directory / std::format("{:016x}.bitec", bite::rapidhash::hash(key.data(), key.size()));
+}
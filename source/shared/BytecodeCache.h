@@ -0,0 +1,48 @@
+#ifndef BYTECODECACHE_H
+#define BYTECODECACHE_H
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+class Function;
+
+/**
+ * On-disk cache of compiled modules.
+ * Entries are keyed by source path and validated against source hash, hashes of imported modules
+ * and bytecode format version, so stale entries are never loaded.
+ */
+class BytecodeCache {
+public:
+    struct Dependency {
+        std::string path;
+        std::uint64_t source_hash;
+    };
+
+    struct Entry {
+        Function* main = nullptr;
+        // every function in entry including main, caller takes ownership
+        std::vector<Function*> functions;
+        std::vector<Dependency> dependencies;
+    };
+
+    explicit BytecodeCache(std::filesystem::path directory) : directory(std::move(directory)) {}
+
+    std::optional<Entry> load(const std::string& source_path, std::uint64_t source_hash) const;
+    bool store(
+        const std::string& source_path,
+        std::uint64_t source_hash,
+        Function* main,
+        const std::vector<Dependency>& dependencies
+    ) const;
+
+    static std::optional<std::uint64_t> hash_file(const std::string& path);
+
+private:
+    [[nodiscard]] std::filesystem::path entry_path(const std::string& source_path) const;
+
+    std::filesystem::path directory;
+};
+
+#endif //BYTECODECACHE_H
@@ -0,0 +1,297 @@
+#ifndef BYTECODEFORMAT_H
+#define BYTECODEFORMAT_H
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../Object.h"
+#include "../base/overloaded.h"
+#include "../base/unordered_dense.h"
+
+// Binary serialization of compiled functions shared by bytecode cache and bytecode images.
+// Everything is written in native byte order, serialized bytecode is meant to be used on the machine that produced it.
+// Function table is written in post order so nested functions always come before functions referencing them.
+
+// bump whenever opcode encoding or serialized layout changes!
+inline constexpr std::uint32_t BYTECODE_FORMAT_VERSION = 7;
+
+// tags follow alternatives order of value_variant_t
+enum class ConstantTag : std::uint8_t {
+    NIL = 0,
+    INT = 1,
+    FLOAT = 2,
+    BOOL = 3,
+    FUNCTION = 4,
+    STRING = 5,
+    UNDEFINED = 6
+};
+
+class BytecodeWriter {
+public:
+    // when code section is provided function code is placed there and only referenced from function table
+    explicit BytecodeWriter(std::string* code_section = nullptr) : code_section(code_section) {}
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    void write(const T& value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void write_string(const std::string& string) {
+        write<std::uint32_t>(string.size());
+        buffer += string;
+    }
+
+    // adds function and every function it references to function table
+    bool collect(Function* function) {
+        if (indices.contains(function)) {
+            return true;
+        }
+        for (const auto& constant : function->get_constants()) {
+            if (auto object = constant.as<Object*>()) {
+                // only functions can be referenced from bytecode constants
+                auto* nested = dynamic_cast<Function*>(*object);
+                if (!nested || !collect(nested)) {
+                    return false;
+                }
+            }
+        }
+        indices[function] = order.size();
+        order.push_back(function);
+        return true;
+    }
+
+    [[nodiscard]] std::uint32_t index_of(Function* function) const {
+        return indices.at(function);
+    }
+
+    void write_function_table() {
+        write<std::uint32_t>(order.size());
+        for (auto* function : order) {
+            write_function(function);
+        }
+    }
+
+    std::string buffer;
+
+private:
+    void write_function(Function* function) {
+        write_string(function->get_name());
+        write<std::int32_t>(function->get_min_arity());
+        write<std::int32_t>(function->get_max_arity());
+        write<std::int32_t>(function->get_upvalue_count());
+        write<std::int32_t>(function->get_max_stack());
+
+        auto code = function->get_program().get_code();
+        if (code_section) {
+            write<std::uint32_t>(code_section->size());
+            write<std::uint32_t>(code.size());
+            code_section->append(reinterpret_cast<const char*>(code.data()), code.size());
+        } else {
+            write<std::uint32_t>(code.size());
+            buffer.append(reinterpret_cast<const char*>(code.data()), code.size());
+        }
+
+        write<std::uint32_t>(function->get_constants().size());
+        for (const auto& constant : function->get_constants()) {
+            write_constant(constant);
+        }
+    }
+
+    void write_constant(const Value& value) {
+        std::visit(
+            overloaded {
+                [this](Nil) { write(ConstantTag::NIL); },
+                [this](Undefined) { write(ConstantTag::UNDEFINED); },
+                [this](bite_int integer) {
+                    write(ConstantTag::INT);
+                    write(integer);
+                },
+                [this](bite_float number) {
+                    write(ConstantTag::FLOAT);
+                    write(number);
+                },
+                [this](bool boolean) {
+                    write(ConstantTag::BOOL);
+                    write<std::uint8_t>(boolean);
+                },
+                [this](const std::string& string) {
+                    write(ConstantTag::STRING);
+                    write_string(string);
+                },
+                [this](Object* object) {
+                    // validated by collect()
+                    write(ConstantTag::FUNCTION);
+                    write(indices[dynamic_cast<Function*>(object)]);
+                }
+            },
+            value
+        );
+    }
+
+    std::string* code_section;
+    bite::unordered_dense::map<Function*, std::uint32_t> indices;
+    std::vector<Function*> order;
+};
+
+class BytecodeReader {
+public:
+    // when code section is provided functions will execute code directly from it without copying
+    explicit BytecodeReader(std::string_view data, std::span<const bite_byte> code_section = {}) : data(data),
+        code_section(code_section) {}
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    std::optional<T> read() {
+        if (data.size() - position < sizeof(T)) {
+            return {};
+        }
+        T value;
+        std::memcpy(&value, data.data() + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    std::optional<std::string_view> read_bytes(std::size_t size) {
+        if (data.size() - position < size) {
+            return {};
+        }
+        auto bytes = data.substr(position, size);
+        position += size;
+        return bytes;
+    }
+
+    std::optional<std::string> read_string() {
+        auto size = read<std::uint32_t>();
+        if (!size) {
+            return {};
+        }
+        auto bytes = read_bytes(*size);
+        if (!bytes) {
+            return {};
+        }
+        return std::string(*bytes);
+    }
+
+    bool match(std::string_view expected) {
+        auto bytes = read_bytes(expected.size());
+        return bytes && *bytes == expected;
+    }
+
+    // on failure all already created functions are destroyed
+    std::optional<std::vector<Function*>> read_function_table() {
+        auto count = read<std::uint32_t>();
+        if (!count) {
+            return {};
+        }
+        std::vector<Function*> functions;
+        for (std::uint32_t i = 0; i < *count; ++i) {
+            if (!read_function(functions)) {
+                for (auto* function : functions) {
+                    delete function;
+                }
+                return {};
+            }
+        }
+        return functions;
+    }
+
+    [[nodiscard]] bool at_end() const {
+        return position == data.size();
+    }
+
+private:
+    bool read_function(std::vector<Function*>& functions) {
+        auto name = read_string();
+        auto min_arity = read<std::int32_t>();
+        auto max_arity = read<std::int32_t>();
+        auto upvalue_count = read<std::int32_t>();
+        auto max_stack = read<std::int32_t>();
+        if (!name || !min_arity || !max_arity || !upvalue_count || !max_stack) {
+            return false;
+        }
+        auto* function = new Function(std::move(*name), *min_arity, *max_arity);
+        functions.push_back(function);
+        function->set_upvalue_count(*upvalue_count);
+        function->set_max_stack(*max_stack);
+
+        if (code_section.data()) {
+            auto offset = read<std::uint32_t>();
+            auto size = read<std::uint32_t>();
+            if (!offset || !size || *offset > code_section.size() || code_section.size() - *offset < *size) {
+                return false;
+            }
+            function->get_program() = Program(code_section.subspan(*offset, *size));
+        } else {
+            auto size = read<std::uint32_t>();
+            if (!size) {
+                return false;
+            }
+            auto code = read_bytes(*size);
+            if (!code) {
+                return false;
+            }
+            for (char byte : *code) {
+                function->get_program().write(static_cast<bite_byte>(byte));
+            }
+        }
+
+        auto constants_size = read<std::uint32_t>();
+        if (!constants_size) {
+            return false;
+        }
+        for (std::uint32_t i = 0; i < *constants_size; ++i) {
+            // function can only reference functions written before it
+            auto constant = read_constant(std::span(functions).first(functions.size() - 1));
+            if (!constant) {
+                return false;
+            }
+            function->add_constant(*constant);
+        }
+        return true;
+    }
+
+    std::optional<Value> read_constant(std::span<Function*> functions) {
+        auto tag = read<ConstantTag>();
+        if (!tag) {
+            return {};
+        }
+        switch (*tag) {
+            case ConstantTag::NIL: return Value(nil_t);
+            case ConstantTag::UNDEFINED: return Value(undefined);
+            case ConstantTag::INT: {
+                auto integer = read<bite_int>();
+                return integer ? std::optional<Value>(*integer) : std::nullopt;
+            }
+            case ConstantTag::FLOAT: {
+                auto number = read<bite_float>();
+                return number ? std::optional<Value>(*number) : std::nullopt;
+            }
+            case ConstantTag::BOOL: {
+                auto boolean = read<std::uint8_t>();
+                return boolean ? std::optional<Value>(*boolean != 0) : std::nullopt;
+            }
+            case ConstantTag::STRING: {
+                auto string = read_string();
+                return string ? std::optional<Value>(std::move(*string)) : std::nullopt;
+            }
+            case ConstantTag::FUNCTION: {
+                auto index = read<std::uint32_t>();
+                if (!index || *index >= functions.size()) {
+                    return {};
+                }
+                return Value(static_cast<Object*>(functions[*index]));
+            }
+        }
+        return {};
+    }
+
+    std::string_view data;
+    std::span<const bite_byte> code_section;
+    std::size_t position = 0;
+};
+
+#endif //BYTECODEFORMAT_H
@@ -0,0 +1,196 @@
+#include "BytecodeImage.h"
+
+#include <cctype>
+#include <format>
+#include <fstream>
+
+#include "BytecodeFormat.h"
+
+// Image layout:
+// magic | format version | code offset | code size | main module name | modules | function table | padding | code
+// Code of all functions is stored in one contiguous, aligned section which is never copied.
+
+namespace {
+    constexpr std::string_view MAGIC = "BITI";
+    constexpr std::size_t HEADER_SIZE = MAGIC.size() + sizeof(std::uint32_t) + 2 * sizeof(std::uint64_t);
+    constexpr std::size_t CODE_ALIGNMENT = 16;
+} // namespace
+
+std::optional<std::string> BytecodeImage::serialize(const std::string& main_module, const std::vector<Module>& modules) {
+    std::string code;
+    BytecodeWriter writer(&code);
+    for (const auto& module : modules) {
+        if (!writer.collect(module.function)) {
+            return {};
+        }
+    }
+    writer.write_string(main_module);
+    writer.write<std::uint32_t>(modules.size());
+    for (const auto& [name, function] : modules) {
+        writer.write_string(name);
+        writer.write(writer.index_of(function));
+    }
+    writer.write_function_table();
+
+    std::size_t metadata_end = HEADER_SIZE + writer.buffer.size();
+    std::size_t code_offset = (metadata_end + CODE_ALIGNMENT - 1) / CODE_ALIGNMENT * CODE_ALIGNMENT;
+
+    BytecodeWriter image;
+    image.buffer += MAGIC;
+    image.write(BYTECODE_FORMAT_VERSION);
+    image.write<std::uint64_t>(code_offset);
+    image.write<std::uint64_t>(code.size());
+    image.buffer += writer.buffer;
+    image.buffer.append(code_offset - metadata_end, '\0');
+    image.buffer += code;
+    return std::move(image.buffer);
+}
+
+bool BytecodeImage::link(
+    const std::filesystem::path& path,
+    const std::string& main_module,
+    const std::vector<Module>& modules
+) {
+    auto image = serialize(main_module, modules);
+    if (!image) {
+        return false;
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    return file && file.write(image->data(), image->size());
+}
+
+bool BytecodeImage::embed(
+    const std::filesystem::path& path,
+    const std::string& symbol,
+    const std::string& main_module,
+    const std::vector<Module>& modules
+) {
+    auto image = serialize(main_module, modules);
+    if (!image) {
+        return false;
+    }
+    std::filesystem::path header_path = std::filesystem::path(path).replace_extension(".h");
+    if (header_path == path) {
+        return false;
+    }
+    std::string guard;
+    for (char c : header_path.filename().string()) {
+        guard += std::isalnum(static_cast<unsigned char>(c)) ? std::toupper(static_cast<unsigned char>(c)) : '_';
+    }
+    std::string header = std::format(
+        "// Generated by bite --embed-image from \"{0}\", do not edit!\n"
+        "#ifndef {1}\n"
+        "#define {1}\n"
+        "#include <span>\n\n"
+        "// linked bytecode image of \"{0}\", run it with BytecodeImage::load\n"
+        "std::span<const unsigned char> {2}();\n\n"
+        "#endif //{1}\n",
+        main_module,
+        guard,
+        symbol
+    );
+    std::ofstream header_file(header_path, std::ios::binary | std::ios::trunc);
+    if (!header_file || !header_file.write(header.data(), header.size())) {
+        return false;
+    }
+
+    std::string source = std::format(
+        "// Generated by bite --embed-image from \"{}\", do not edit!\n"
+        "// Bytecode format version {}, regenerate whenever bite is updated.\n"
+        "#include \"{}\"\n\n"
+        "namespace {{\n"
+        "    // aligned same as code section inside image so code can be executed in place\n"
+        "    alignas({}) const unsigned char image[] = {{",
+        main_module,
+        BYTECODE_FORMAT_VERSION,
+        header_path.filename().string(),
+        CODE_ALIGNMENT
+    );
+    for (std::size_t i = 0; i < image->size(); ++i) {
+        source += i % 16 == 0 ? "\n        " : " ";
+        source += std::format("0x{:02x},", static_cast<unsigned char>((*image)[i]));
+    }
+    source += std::format(
+        "\n    }};\n"
+        "}} // namespace\n\n"
+        "std::span<const unsigned char> {}() {{\n"
+        "    return image;\n"
+        "}}\n",
+        symbol
+    );
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    return file && file.write(source.data(), source.size());
+}
+
+std::optional<BytecodeImage> BytecodeImage::load(const std::filesystem::path& path) {
+    auto file = bite::mapped_file::open(path);
+    if (!file) {
+        return {};
+    }
+    auto image = load(file->data());
+    if (image) {
+        image->file = std::move(*file);
+    }
+    return image;
+}
+
+std::optional<BytecodeImage> BytecodeImage::load(std::span<const unsigned char> bytes) {
+    std::string_view data(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+
+    BytecodeReader header(data);
+    if (!header.match(MAGIC) || header.read<std::uint32_t>() != BYTECODE_FORMAT_VERSION) {
+        return {};
+    }
+    auto code_offset = header.read<std::uint64_t>();
+    auto code_size = header.read<std::uint64_t>();
+    if (!code_offset || !code_size || *code_offset < HEADER_SIZE || *code_offset > data.size() || data.size() - *
+        code_offset < *code_size) {
+        return {};
+    }
+
+    BytecodeReader reader(
+        data.substr(HEADER_SIZE, *code_offset - HEADER_SIZE),
+        bytes.subspan(*code_offset, *code_size)
+    );
+    auto main_module = reader.read_string();
+    auto modules_count = reader.read<std::uint32_t>();
+    if (!main_module || !modules_count) {
+        return {};
+    }
+    std::vector<std::pair<std::string, std::uint32_t>> module_indices;
+    for (std::uint32_t i = 0; i < *modules_count; ++i) {
+        auto name = reader.read_string();
+        auto index = reader.read<std::uint32_t>();
+        if (!name || !index) {
+            return {};
+        }
+        module_indices.emplace_back(std::move(*name), *index);
+    }
+
+    auto functions = reader.read_function_table();
+    if (!functions) {
+        return {};
+    }
+    std::vector<Module> modules;
+    for (auto& [name, index] : module_indices) {
+        if (index >= functions->size()) {
+            for (auto* function : *functions) {
+                delete function;
+            }
+            return {};
+        }
+        modules.emplace_back(std::move(name), (*functions)[index]);
+    }
+    return BytecodeImage {
+            .main_module = std::move(*main_module),
+            .modules = std::move(modules),
+            .functions = std::move(*functions),
+            .file = {}
+        };
+}
+
+bool BytecodeImage::is_image(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::string magic(MAGIC.size(), '\0');
+    return file.read(magic.data(), magic.size()) && magic == MAGIC;
+}
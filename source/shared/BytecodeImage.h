@@ -0,0 +1,50 @@
+#ifndef BYTECODEIMAGE_H
+#define BYTECODEIMAGE_H
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "../base/mapped_file.h"
+
+class Function;
+
+/**
+ * Single file containing compiled program together with every module it imports.
+ * Image is memory mapped and bytecode is executed directly from mapped pages,
+ * so processes running the same image share its code.
+ * Image can be also embedded into host binary as generated C++ source and executed directly from its data section,
+ * generated source contains only image bytes, bytecode is still run by the vm.
+ */
+class BytecodeImage {
+public:
+    struct Module {
+        std::string name;
+        Function* function;
+    };
+
+    static std::optional<std::string> serialize(const std::string& main_module, const std::vector<Module>& modules);
+    static bool link(const std::filesystem::path& path, const std::string& main_module, const std::vector<Module>& modules);
+    // writes C++ source defining function `std::span<const unsigned char> symbol()` returning the image
+    // and header declaring it next to the source (same path with .h extension)
+    static bool embed(
+        const std::filesystem::path& path,
+        const std::string& symbol,
+        const std::string& main_module,
+        const std::vector<Module>& modules
+    );
+    static std::optional<BytecodeImage> load(const std::filesystem::path& path);
+    // functions code points directly into data so it must outlive them
+    static std::optional<BytecodeImage> load(std::span<const unsigned char> data);
+    static bool is_image(const std::filesystem::path& path);
+
+    std::string main_module;
+    std::vector<Module> modules;
+    // every function in image, caller takes ownership
+    std::vector<Function*> functions;
+    // functions code points into mapping so it must outlive them, empty for images loaded from memory
+    std::optional<bite::mapped_file> file;
+};
+
+#endif //BYTECODEIMAGE_H
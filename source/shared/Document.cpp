@@ -0,0 +1,169 @@
+#include "Document.h"
+
+#include <algorithm>
+#include <ranges>
+#include <utility>
+
+#include "SharedContext.h"
+#include "../Analyzer.h"
+#include "../parser/Parser.h"
+
+namespace {
+    // analyzer reports into shared diagnostics, collect only diagnostics produced by fn
+    std::vector<bite::Diagnostic> collect_diagnostics(SharedContext* context, const auto& fn) {
+        auto previous = std::exchange(context->diagnostics, {});
+        fn();
+        auto collected = context->diagnostics.take();
+        context->diagnostics = std::move(previous);
+        return collected;
+    }
+} // namespace
+
+Document::Document(SharedContext* context, std::string path, std::string text) : context(context),
+    path(std::move(path)),
+    m_text(std::move(text)) {
+    file_id = context->files.id_of(context->intern(this->path));
+    reparse();
+}
+
+void Document::edit(const std::size_t start, const std::size_t end, const std::string_view replacement) {
+    BITE_ASSERT(start <= end && end <= m_text.size());
+    m_text.replace(start, end - start, replacement);
+    auto delta = static_cast<std::int64_t>(replacement.size()) - static_cast<std::int64_t>(end - start);
+    m_was_incremental = retired_nodes <= live_nodes && reparse_function(start, end, delta);
+    if (!m_was_incremental) {
+        reparse();
+    }
+}
+
+void Document::reparse() {
+    Parser parser { bite::source_input_stream(path, m_text), context };
+    Ast fresh = parser.parse();
+    has_parse_errors = parser.has_errors();
+
+    // old trees have to be destroyed before arenas holding their nodes
+    m_ast = Ast {};
+    retired_statements.clear();
+    arenas.clear();
+    live_nodes = fresh.arena->allocation_count();
+    retired_nodes = 0;
+    arenas.push_back(std::move(fresh.arena));
+    m_ast = std::move(fresh);
+
+    statements.clear();
+    for (const auto& stmt : m_ast.stmts) {
+        statements.emplace_back(stmt->span.start_offset, stmt->span.end_offset);
+    }
+    m_diagnostics.clear();
+    add_diagnostics(parser.get_diagnostics().take());
+    // same as compilation, analysis of unparsable source would only report follow-up errors
+    if (!has_parse_errors) {
+        add_diagnostics(
+            collect_diagnostics(
+                context,
+                [this] {
+                    bite::Analyzer analyzer { context };
+                    analyzer.analyze(m_ast);
+                }
+            )
+        );
+    }
+}
+
+// Reparsed function must end at the same token (shifted by the edit) so text after it is lexed and parsed exactly
+// like before. Its name must stay the same as other statements only depend on declared global names.
+bool Document::reparse_function(const std::size_t start, const std::size_t end, const std::int64_t delta) {
+    if (has_parse_errors || statements.empty()) {
+        return false;
+    }
+    std::size_t index = statement_at(start);
+    if (index == NO_STATEMENT || end > statements[index].end) {
+        return false;
+    }
+    auto* previous = dynamic_cast<FunctionDeclaration*>(m_ast.stmts[index].get());
+    if (!previous) {
+        return false;
+    }
+    auto range = statements[index];
+    std::size_t new_end = range.end + delta;
+
+    // stream ends with the function so the parser can't continue into following statements
+    bite::source_input_stream stream(path, std::string_view(m_text).substr(0, new_end));
+    stream.advance_to(range.start);
+    Parser parser { std::move(stream), context };
+    Ast window = parser.parse();
+    auto parse_diagnostics = parser.get_diagnostics().take();
+    if (parser.has_errors() || !parse_diagnostics.empty() || window.stmts.size() != 1) {
+        return false;
+    }
+    auto* function = dynamic_cast<FunctionDeclaration*>(window.stmts.front().get());
+    if (!function || function->name.string != previous->name.string || function->span.start_offset != range.start
+        || function->span.end_offset != new_end) {
+        return false;
+    }
+
+    retired_statements.push_back(std::exchange(m_ast.stmts[index], std::move(window.stmts.front())));
+    retired_nodes += window.arena->allocation_count();
+    arenas.push_back(std::move(window.arena));
+
+    statements[index].end = new_end;
+    for (auto& statement : statements | std::views::drop(index + 1)) {
+        statement.start += delta;
+        statement.end += delta;
+    }
+    std::erase_if(m_diagnostics, [index](const OwnedDiagnostic& owned) { return owned.statement == index; });
+    for (auto& [diagnostic, _] : m_diagnostics) {
+        for (auto& hint : diagnostic.inline_hints) {
+            if (hint.location.file_id == file_id && hint.location.start_offset >= range.end) {
+                hint.location.start_offset = static_cast<std::uint32_t>(hint.location.start_offset + delta);
+                hint.location.end_offset = static_cast<std::uint32_t>(hint.location.end_offset + delta);
+            }
+        }
+    }
+
+    add_diagnostics(
+        collect_diagnostics(
+            context,
+            [this, function] {
+                bite::Analyzer analyzer { context };
+                analyzer.reanalyze_function(m_ast, *function);
+            }
+        )
+    );
+    return true;
+}
+
+void Document::add_diagnostics(std::vector<bite::Diagnostic> diagnostics) {
+    for (auto& diagnostic : diagnostics) {
+        std::size_t statement = NO_STATEMENT;
+        if (!diagnostic.inline_hints.empty() && diagnostic.inline_hints.front().location.file_id == file_id) {
+            statement = statement_at(diagnostic.inline_hints.front().location.start_offset);
+        }
+        m_diagnostics.emplace_back(std::move(diagnostic), statement);
+    }
+}
+
+std::size_t Document::statement_at(const std::size_t offset) const {
+    auto next = std::ranges::upper_bound(statements, offset, {}, &StatementRange::start);
+    if (next == statements.begin() || offset > std::prev(next)->end) {
+        return NO_STATEMENT;
+    }
+    return std::distance(statements.begin(), next) - 1;
+}
+
+std::vector<bite::Diagnostic> Document::diagnostics() const {
+    std::vector<bite::Diagnostic> diagnostics;
+    for (const auto& owned : m_diagnostics) {
+        diagnostics.push_back(owned.diagnostic);
+    }
+    return diagnostics;
+}
+
+void Document::print_diagnostics(std::ostream& output, const bool is_terminal) {
+    context->sources.update(context->intern(path), m_text);
+    bite::DiagnosticManager manager;
+    for (const auto& owned : m_diagnostics) {
+        manager.add(owned.diagnostic);
+    }
+    manager.print(context->files, context->sources, output, is_terminal);
+}
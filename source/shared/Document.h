@@ -0,0 +1,88 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../Ast.h"
+#include "../Diagnostics.h"
+#include "../base/arena.h"
+
+class SharedContext;
+
+/**
+ * Source file edited in place (f.e. by an editor showing live diagnostics) kept parsed and analyzed between edits.
+ * Edit which stays within a top-level function and keeps it a single function of the same name only relexes,
+ * reparses and reanalyzes that function, diagnostics of other statements are reused. Any other edit reparses
+ * and reanalyzes the whole document.
+ */
+class Document {
+public:
+    Document(SharedContext* context, std::string path, std::string text);
+
+    Document(const Document&) = delete;
+    Document& operator=(const Document&) = delete;
+
+    // replaces bytes [start, end) of the text
+    void edit(std::size_t start, std::size_t end, std::string_view replacement);
+
+    [[nodiscard]] const std::string& text() const {
+        return m_text;
+    }
+
+    // spans of statements not touched by incremental edits are not updated, use only for inspecting structure
+    [[nodiscard]] const Ast& ast() const {
+        return m_ast;
+    }
+
+    [[nodiscard]] std::vector<bite::Diagnostic> diagnostics() const;
+    // source lines are printed from edited text instead of the file on disk
+    void print_diagnostics(std::ostream& output, bool is_terminal = false);
+
+    // whether the last edit was handled without reparsing whole document
+    [[nodiscard]] bool was_incremental() const {
+        return m_was_incremental;
+    }
+
+private:
+    static constexpr std::size_t NO_STATEMENT = SIZE_MAX;
+
+    // current offsets of top-level statement, its nodes keep offsets from the time they were parsed
+    struct StatementRange {
+        std::size_t start;
+        std::size_t end;
+    };
+
+    struct OwnedDiagnostic {
+        bite::Diagnostic diagnostic;
+        // top-level statement which diagnostic points into, dropped when the statement is reparsed
+        std::size_t statement;
+    };
+
+    void reparse();
+    bool reparse_function(std::size_t start, std::size_t end, std::int64_t delta);
+    void add_diagnostics(std::vector<bite::Diagnostic> diagnostics);
+    [[nodiscard]] std::size_t statement_at(std::size_t offset) const;
+
+    SharedContext* context;
+    std::string path;
+    FileTable::Id file_id;
+    std::string m_text;
+    // declared before trees so they are destroyed after all nodes placed in them
+    std::vector<std::unique_ptr<bite::Arena>> arenas;
+    // replaced by incremental edits, kept as bindings of other statements still point into them
+    std::vector<std::unique_ptr<Stmt>> retired_statements;
+    Ast m_ast;
+    std::vector<StatementRange> statements;
+    std::vector<OwnedDiagnostic> m_diagnostics;
+    bool has_parse_errors = false;
+    bool m_was_incremental = false;
+    // nodes of the last full parse and of retired statements, whole document is reparsed when retired outweigh it
+    std::size_t live_nodes = 0;
+    std::size_t retired_nodes = 0;
+};
+
+#endif //DOCUMENT_H
@@ -0,0 +1,44 @@
+#ifndef FILETABLE_H
+#define FILETABLE_H
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "StringTable.h"
+#include "../base/debug.h"
+#include "../base/unordered_dense.h"
+
+/**
+ * Numbers source files so source spans refer to them by 32-bit id instead of path handle.
+ * Id 0 is reserved for spans which don't belong to any file.
+ */
+class FileTable {
+public:
+    using Id = std::uint32_t;
+    static constexpr Id NO_FILE = 0;
+
+    FileTable() : paths { nullptr } {}
+
+    // safe to call from multiple threads as files are lexed concurrently
+    Id id_of(StringTable::Handle path) {
+        std::lock_guard lock(mutex);
+        auto [it, inserted] = ids.try_emplace(path, static_cast<Id>(paths.size()));
+        if (inserted) {
+            paths.push_back(path);
+        }
+        return it->second;
+    }
+
+    StringTable::Handle path_of(Id id) const {
+        std::lock_guard lock(mutex);
+        BITE_ASSERT(id < paths.size());
+        return paths[id];
+    }
+
+private:
+    mutable std::mutex mutex;
+    bite::unordered_dense::map<StringTable::Handle, Id> ids;
+    std::vector<StringTable::Handle> paths;
+};
+
+#endif //FILETABLE_H
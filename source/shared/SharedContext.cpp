@@ -1,5 +1,12 @@
 #include "SharedContext.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <experimental/scope>
+#include <format>
+#include <thread>
+
 #include "../Analyzer.h"
 #include "../Compiler.h"
 #include "../parser/Parser.h"
@@ -19,44 +26,517 @@ Value FunctionContext::allocate(Object* object) {
 }
 
 // TODO: circular?
-Module* SharedContext::get_module(StringTable::Handle name) {
+Module* SharedContext::get_module(StringTable::Handle name, bool need_declarations) {
+    Module* module = nullptr;
     if (modules.contains(name)) {
-        return modules[name].get();
+        module = modules[name].get();
+        auto* file_module = dynamic_cast<FileModule*>(module);
+        if (need_declarations && file_module && !file_module->ast) {
+            // cached and released modules carry only bytecode, recover declarations from source
+            auto cached = std::move(modules[name]);
+            FileModule* fresh = compile(*name, false);
+            if (!fresh) {
+                modules[name] = std::move(cached);
+                return nullptr;
+            }
+            if (file_module->m_was_executed) {
+                fresh->m_was_executed = true;
+                fresh->values = std::move(file_module->values);
+            }
+            module = fresh;
+        }
+    } else if (std::filesystem::exists(*name)) {
+        module = compile(*name, !need_declarations);
     }
-    if (std::filesystem::exists(*name)) {
-        return compile(*name);
+    if (module && !compiling_dependencies.empty() && dynamic_cast<FileModule*>(module) && !std::ranges::contains(
+        compiling_dependencies.back(),
+        name
+    )) {
+        compiling_dependencies.back().push_back(name);
     }
-    return nullptr;
+    return module;
 }
 
-FileModule* SharedContext::compile(const std::string& name) {
-    Parser parser { bite::file_input_stream(name), this };
-    ast_storage.push_back(parser.parse());
-    auto& ast = ast_storage.back();
-    if (parser.has_errors()) {
-        diagnostics.print(std::cout, true);
+namespace {
+    // Function bodies can't influence analysis of importers so only their signatures are fingerprinted,
+    // other declarations (classes, traits, objects, modules) are fingerprinted whole. Reexported declarations
+    // are located in other files, these are covered by fingerprint of imported modules.
+    std::uint64_t compute_exports_fingerprint(
+        const std::string_view source,
+        const FileTable::Id file_id,
+        const bite::unordered_dense::map<StringTable::Handle, Declaration*>& declarations,
+        const std::uint64_t imports_fingerprint
+    ) {
+        std::vector<std::pair<std::string_view, std::string_view>> exports;
+        for (const auto& [name, declaration] : declarations) {
+            std::string_view text;
+            if (declaration && declaration->span.file_id == file_id) {
+                std::int64_t start = declaration->span.start_offset;
+                std::int64_t end = declaration->span.end_offset;
+                if (auto* function = dynamic_cast<const FunctionDeclaration*>(declaration); function && function->body) {
+                    end = function->body->span.start_offset;
+                }
+                if (0 <= start && start <= end && end <= static_cast<std::int64_t>(source.size())) {
+                    text = source.substr(start, end - start);
+                }
+            }
+            exports.emplace_back(*name, text);
+        }
+        std::ranges::sort(exports);
+        std::string key(reinterpret_cast<const char*>(&imports_fingerprint), sizeof(imports_fingerprint));
+        for (const auto& [name, text] : exports) {
+            key += name;
+            key += '\0';
+            key += text;
+            key += '\0';
+        }
+        return bite::rapidhash::hash(key.data(), key.size());
+    }
+} // namespace
+
+FileModule* SharedContext::compile(const std::string& name, bool use_cache) {
+    auto handle = intern(name);
+    // file could have changed since it was last read, unless it was parsed ahead from the cached text
+    if (!parsed_files.contains(handle)) {
+        sources.invalidate(handle);
+    }
+    const SourceFile* source = sources.get(handle);
+    std::optional<std::uint64_t> source_hash;
+    if (source) {
+        source_hash = bite::rapidhash::hash(source->text().data(), source->text().size());
+    }
+    if (bytecode_cache && use_cache && source_hash) {
+        if (auto* module = load_from_cache(name, *source_hash)) {
+            return module;
+        }
+    }
+
+    compiling_dependencies.emplace_back();
+    auto pop_dependencies = std::experimental::scope_exit(
+        [this] {
+            compiling_dependencies.pop_back();
+        }
+    );
+    // hash, fingerprint and diagnostics are computed from the same text which is parsed
+    auto parsed = parsed_files.contains(handle) ? std::move(parsed_files[handle]) : parse_file(name, source);
+    parsed_files.erase(handle);
+    auto ast = std::make_unique<Ast>(std::move(parsed.ast));
+    diagnostics.merge(std::move(parsed.diagnostics));
+    if (parsed.has_errors) {
+        diagnostics.print(files, sources, std::cout, true);
         return nullptr;
     }
+    parse_imports(*ast);
     bite::Analyzer analyzer { this };
-    analyzer.analyze(ast);
+    analyzer.analyze(*ast);
     if (analyzer.has_errors()) {
-        diagnostics.print(std::cout, true);
+        diagnostics.print(files, sources, std::cout, true);
         return nullptr;
     }
     Compiler compiler { this };
-    compiler.compile(&ast);
+    bool is_compiled = compiler.compile(ast.get());
     for (auto* function : compiler.get_functions()) {
         gc.add_object(function);
     }
+    if (!is_compiled) {
+        for (const auto& error : compiler.get_errors()) {
+            logger.log(bite::Logger::Level::error, "{}: {}", name, error.what());
+        }
+        return nullptr;
+    }
+
+    // module with a function which can't be compiled still runs until that function is called, but isn't cached
+    if (bytecode_cache && source_hash && compile_lazy_recursive(compiler.get_main())) {
+        bytecode_cache->store(
+            name,
+            *source_hash,
+            compiler.get_main(),
+            collect_cache_dependencies(compiling_dependencies.back())
+        );
+    }
+
     // Bite automatically exports all globals declarations, this can change in future.
     bite::unordered_dense::map<StringTable::Handle, Declaration*> declarations;
-    for (auto& [name, global] : ast.enviroment.globals) {
+    for (auto& [name, global] : ast->enviroment.globals) {
         declarations[name] = global.declaration;
     }
-    modules[intern(name)] = std::make_unique<FileModule>(compiler.get_main(), std::move(declarations));
+    auto exports_fingerprint = compute_exports_fingerprint(
+        source ? source->text() : std::string_view(),
+        files.id_of(handle),
+        declarations,
+        compute_imports_fingerprint(compiling_dependencies.back())
+    );
+    auto module = std::make_unique<FileModule>(compiler.get_main(), std::move(declarations));
+    module->source_hash = source_hash.value_or(0);
+    module->exports_fingerprint = exports_fingerprint;
+    module->dependencies = std::move(compiling_dependencies.back());
+    module->ast = std::move(ast);
+    modules[intern(name)] = std::move(module);
     return static_cast<FileModule*>(modules[intern(name)].get());
 }
 
+SharedContext::ParsedFile SharedContext::parse_file(const std::string& file, const SourceFile* source) {
+    auto fail = [](const std::string& message) {
+        ParsedFile parsed;
+        parsed.has_errors = true;
+        parsed.diagnostics.add({ .level = bite::DiagnosticLevel::ERROR, .message = message });
+        return parsed;
+    };
+    if (!source) {
+        return fail(std::format("source file {} can't be read", file));
+    }
+    if (source->text().size() > bite::SourceSpan::MAX_OFFSET) {
+        return fail(std::format("source file {} is too large, size is limited to 4 GiB", file));
+    }
+    Parser parser { bite::source_input_stream(file, source->text()), this };
+    ParsedFile parsed { .ast = parser.parse() };
+    parsed.has_errors = parser.has_errors();
+    parsed.diagnostics = std::move(parser.get_diagnostics());
+    return parsed;
+}
+
+namespace {
+    void collect_imports(const std::vector<std::unique_ptr<Stmt>>& stmts, std::vector<std::string>& imports) {
+        for (const auto& stmt : stmts) {
+            if (auto* import = dynamic_cast<const ImportStmt*>(stmt.get())) {
+                if (auto* path = dynamic_cast<const StringExpr*>(import->module.get())) {
+                    imports.push_back(path->string);
+                }
+            } else if (auto* module = dynamic_cast<const ModuleStmt*>(stmt.get())) {
+                collect_imports(module->stmts, imports);
+            }
+        }
+    }
+} // namespace
+
+// Imported files are independent of each other until analysis, so whole import graph is discovered
+// and parsed concurrently before analysis of the importing file, level by level.
+// Analysis stays sequential as it needs declarations of already analyzed imports.
+// Diagnostics are kept per file and merged in order in which files are compiled so output is deterministic.
+void SharedContext::parse_imports(const Ast& ast) {
+    std::vector<StringTable::Handle> pending;
+    auto discover = [&](const Ast& source) {
+        std::vector<std::string> imports;
+        collect_imports(source.stmts, imports);
+        for (const auto& import : imports) {
+            auto name = intern(import);
+            if (!modules.contains(name) && !parsed_files.contains(name) && !std::ranges::contains(pending, name)
+                && std::filesystem::exists(import)) {
+                pending.push_back(name);
+            }
+        }
+    };
+    discover(ast);
+
+    while (!pending.empty()) {
+        std::vector<ParsedFile> results(pending.size());
+        std::atomic<std::size_t> next_file = 0;
+        {
+            std::size_t worker_count = std::min<std::size_t>(
+                std::max(std::thread::hardware_concurrency(), 1u),
+                pending.size()
+            );
+            std::vector<std::jthread> workers;
+            for (std::size_t i = 0; i < worker_count; ++i) {
+                workers.emplace_back(
+                    [&] {
+                        // source cache is not synchronized, read sources are moved into it once all workers finish
+                        for (std::size_t idx = next_file++; idx < pending.size(); idx = next_file++) {
+                            auto source = SourceFile::read(*pending[idx]);
+                            results[idx] = parse_file(*pending[idx], source.get());
+                            results[idx].source = std::move(source);
+                        }
+                    }
+                );
+            }
+        }
+        auto batch = std::move(pending);
+        pending.clear();
+        for (std::size_t i = 0; i < batch.size(); ++i) {
+            if (results[i].source) {
+                sources.update(batch[i], std::move(results[i].source));
+            }
+            parsed_files[batch[i]] = std::move(results[i]);
+        }
+        for (auto name : batch) {
+            discover(parsed_files[name].ast);
+        }
+    }
+}
+
+bool SharedContext::compile_lazy(Function* function) {
+    Compiler compiler { this };
+    bool is_compiled = compiler.compile_lazy(function);
+    for (auto* nested : compiler.get_functions()) {
+        gc.add_object(nested);
+    }
+    for (const auto& error : compiler.get_errors()) {
+        logger.log(bite::Logger::Level::error, "{}", error.what());
+    }
+    return is_compiled;
+}
+
+// serialized bytecode must be complete so compile every function which was not called yet
+bool SharedContext::compile_lazy_recursive(Function* function) {
+    if (!function->is_compiled() && !compile_lazy(function)) {
+        return false;
+    }
+    bool is_compiled = true;
+    for (const auto& constant : function->get_constants()) {
+        if (auto object = constant.as<Object*>()) {
+            if (auto* nested = dynamic_cast<Function*>(*object)) {
+                is_compiled &= compile_lazy_recursive(nested);
+            }
+        }
+    }
+    return is_compiled;
+}
+
+std::vector<StringTable::Handle> SharedContext::recompile_changed() {
+    // dependencies first so importers are analyzed against already recompiled modules
+    std::vector<StringTable::Handle> order;
+    bite::unordered_dense::set<StringTable::Handle> visited;
+    auto visit = [&](this const auto& self, StringTable::Handle name) -> void {
+        if (visited.contains(name) || !modules.contains(name)) {
+            return;
+        }
+        visited.insert(name);
+        auto* module = dynamic_cast<FileModule*>(modules[name].get());
+        if (!module) {
+            return;
+        }
+        for (auto dependency : module->dependencies) {
+            self(dependency);
+        }
+        order.push_back(name);
+    };
+    for (auto& [name, _] : modules) {
+        visit(name);
+    }
+
+    std::vector<StringTable::Handle> recompiled;
+    // modules which declarations visible to importers changed
+    bite::unordered_dense::set<StringTable::Handle> exports_changed;
+    // modules which have to be executed again so importers observe new values
+    bite::unordered_dense::set<StringTable::Handle> invalidated;
+    for (auto name : order) {
+        auto* module = static_cast<FileModule*>(modules[name].get());
+        bool needs_recompilation = BytecodeCache::hash_file(*name) != module->source_hash || std::ranges::any_of(
+            module->dependencies,
+            [&](auto dependency) { return exports_changed.contains(dependency); }
+        );
+        bool needs_execution = std::ranges::any_of(
+            module->dependencies,
+            [&](auto dependency) { return invalidated.contains(dependency); }
+        );
+        if (needs_recompilation) {
+            auto previous = std::move(modules[name]);
+            FileModule* fresh = compile(*name, false);
+            if (!fresh) {
+                // keep old version running, diagnostics were already reported
+                modules[name] = std::move(previous);
+                continue;
+            }
+            auto* previous_module = static_cast<FileModule*>(previous.get());
+            if (previous_module->is_precompiled || fresh->exports_fingerprint != previous_module->exports_fingerprint) {
+                exports_changed.insert(name);
+            }
+            if (previous_module->ast) {
+                // closures of old version can still be called
+                if (compile_lazy_recursive(previous_module->function)) {
+                    retired_syntax_trees.push_back(std::move(previous_module->ast));
+                } else {
+                    pinned_syntax_trees.push_back(std::move(previous_module->ast));
+                }
+            }
+            recompiled.push_back(name);
+            invalidated.insert(name);
+        } else if (needs_execution) {
+            module->m_was_executed = false;
+            module->values.clear();
+            invalidated.insert(name);
+        }
+    }
+    return recompiled;
+}
+
+// Lazy functions reference declarations of their own module and of imported modules, so everything is compiled
+// before any tree is freed. Analyzer state lives in the trees as well and goes away with them.
+bool SharedContext::release_syntax_trees() {
+    std::size_t failed_modules = 0;
+    for (auto& [_, module] : modules) {
+        if (auto* file_module = dynamic_cast<FileModule*>(module.get()); file_module && file_module->ast) {
+            if (!compile_lazy_recursive(file_module->function)) {
+                ++failed_modules;
+            }
+        }
+    }
+    if (failed_modules != 0) {
+        logger.log(
+            bite::Logger::Level::error,
+            "syntax trees are kept, functions of {} modules can't be compiled",
+            failed_modules
+        );
+        return false;
+    }
+    for (auto& [_, module] : modules) {
+        if (auto* file_module = dynamic_cast<FileModule*>(module.get())) {
+            file_module->declarations.clear();
+            file_module->ast.reset();
+        }
+    }
+    retired_syntax_trees.clear();
+    parsed_files.clear();
+    sources.clear();
+    return true;
+}
+
+FileModule* SharedContext::load_from_cache(const std::string& file, std::uint64_t source_hash) {
+    auto entry = bytecode_cache->load(file, source_hash);
+    if (!entry) {
+        return nullptr;
+    }
+    for (auto* function : entry->functions) {
+        gc.add_object(function);
+    }
+    auto module = std::make_unique<FileModule>(entry->main, bite::unordered_dense::map<StringTable::Handle, Declaration*> {});
+    module->is_precompiled = true;
+    module->source_hash = source_hash;
+    for (const auto& dependency : entry->dependencies) {
+        module->dependencies.push_back(intern(dependency.path));
+    }
+    modules[intern(file)] = std::move(module);
+    return static_cast<FileModule*>(modules[intern(file)].get());
+}
+
+std::optional<std::vector<BytecodeImage::Module>> SharedContext::compile_image_modules(const std::string& file) {
+    // image must contain every imported module so skip cache which would load them lazily
+    FileModule* main_module = compile(file, false);
+    if (!main_module) {
+        return {};
+    }
+    std::vector<BytecodeImage::Module> image_modules;
+    for (auto& [name, module] : modules) {
+        if (auto* file_module = dynamic_cast<FileModule*>(module.get())) {
+            if (!compile_lazy_recursive(file_module->function)) {
+                return {};
+            }
+            image_modules.emplace_back(*name, file_module->function);
+        }
+    }
+    return image_modules;
+}
+
+bool SharedContext::link_image(const std::string& file, const std::filesystem::path& output) {
+    auto image_modules = compile_image_modules(file);
+    return image_modules && BytecodeImage::link(output, file, *image_modules);
+}
+
+bool SharedContext::embed_image(const std::string& file, const std::filesystem::path& output) {
+    auto image_modules = compile_image_modules(file);
+    if (!image_modules) {
+        return false;
+    }
+    // function name derived from script name so multiple scripts can be embedded into the same binary
+    std::string symbol = "bite_image_";
+    for (char c : std::filesystem::path(file).stem().string()) {
+        symbol += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    return BytecodeImage::embed(output, symbol, file, *image_modules);
+}
+
+FileModule* SharedContext::load_image(const std::filesystem::path& path) {
+    auto image = BytecodeImage::load(path);
+    return image ? register_image(*image) : nullptr;
+}
+
+FileModule* SharedContext::load_image(std::span<const unsigned char> data) {
+    auto image = BytecodeImage::load(data);
+    return image ? register_image(*image) : nullptr;
+}
+
+FileModule* SharedContext::register_image(BytecodeImage& image) {
+    for (auto* function : image.functions) {
+        gc.add_object(function);
+    }
+    for (auto& [name, function] : image.modules) {
+        auto module = std::make_unique<FileModule>(function, bite::unordered_dense::map<StringTable::Handle, Declaration*> {});
+        module->is_precompiled = true;
+        modules[intern(name)] = std::move(module);
+    }
+    if (image.file) {
+        mapped_images.push_back(std::move(*image.file));
+    }
+    auto main_module = intern(image.main_module);
+    return modules.contains(main_module) ? dynamic_cast<FileModule*>(modules[main_module].get()) : nullptr;
+}
+
+// analysis of module depends on declarations of every module it imports even transitively (reexports)
+std::vector<BytecodeCache::Dependency> SharedContext::collect_cache_dependencies(
+    const std::vector<StringTable::Handle>& imports
+) {
+    std::vector<BytecodeCache::Dependency> dependencies;
+    bite::unordered_dense::set<StringTable::Handle> visited;
+    auto collect = [&](this const auto& self, StringTable::Handle name) -> void {
+        if (visited.contains(name)) {
+            return;
+        }
+        visited.insert(name);
+        auto* module = modules.contains(name) ? dynamic_cast<FileModule*>(modules[name].get()) : nullptr;
+        if (!module) {
+            if (auto hash = BytecodeCache::hash_file(*name)) {
+                dependencies.emplace_back(*name, *hash);
+            }
+            return;
+        }
+        dependencies.emplace_back(*name, module->source_hash);
+        for (auto dependency : module->dependencies) {
+            self(dependency);
+        }
+    };
+    for (auto name : imports) {
+        collect(name);
+    }
+    return dependencies;
+}
+
+// Imported declarations can be reexported (or used in signatures), so any change of exports of a module
+// imported even transitively changes exports of the importer too. Precompiled modules have no fingerprint,
+// their source hash is used instead.
+std::uint64_t SharedContext::compute_imports_fingerprint(const std::vector<StringTable::Handle>& imports) {
+    std::vector<std::pair<std::string_view, std::uint64_t>> fingerprints;
+    bite::unordered_dense::set<StringTable::Handle> visited;
+    auto collect = [&](this const auto& self, StringTable::Handle name) -> void {
+        if (visited.contains(name)) {
+            return;
+        }
+        visited.insert(name);
+        auto* module = modules.contains(name) ? dynamic_cast<FileModule*>(modules[name].get()) : nullptr;
+        if (!module) {
+            return;
+        }
+        fingerprints.emplace_back(*name, module->is_precompiled ? module->source_hash : module->exports_fingerprint);
+        for (auto dependency : module->dependencies) {
+            self(dependency);
+        }
+    };
+    for (auto name : imports) {
+        collect(name);
+    }
+    std::ranges::sort(fingerprints);
+    std::string key;
+    for (const auto& [name, fingerprint] : fingerprints) {
+        key += name;
+        key += '\0';
+        key.append(reinterpret_cast<const char*>(&fingerprint), sizeof(fingerprint));
+    }
+    return bite::rapidhash::hash(key.data(), key.size());
+}
+
+void SharedContext::enable_bytecode_cache(std::filesystem::path directory) {
+    bytecode_cache.emplace(std::move(directory));
+}
+
 void SharedContext::add_module(const StringTable::Handle name, std::unique_ptr<ForeignModule> module) {
     modules[name] = std::move(module);
 }
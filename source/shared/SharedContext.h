@@ -3,6 +3,10 @@
 #include <fstream>
 #include <stack>
 
+#include "BytecodeCache.h"
+#include "BytecodeImage.h"
+#include "FileTable.h"
+#include "SourceCache.h"
 #include "StringTable.h"
 #include "../Diagnostics.h"
 #include "../base/logger.h"
@@ -51,7 +55,16 @@ public:
 class FileModule final : public Module {
 public:
     bool m_was_executed = false;
+    // modules loaded from bytecode cache or image don't have declarations nor syntax tree
+    bool is_precompiled = false;
+    std::uint64_t source_hash = 0;
+    // changes only when declarations visible to importers change, zero for precompiled modules
+    std::uint64_t exports_fingerprint = 0;
+    std::vector<StringTable::Handle> dependencies; // imported file modules
     Function* function;
+    // owns nodes referenced by declarations and by functions which are not compiled yet,
+    // null for precompiled modules and after SharedContext::release_syntax_trees
+    std::unique_ptr<Ast> ast;
     bite::unordered_dense::map<StringTable::Handle, Declaration*> declarations;
     bite::unordered_dense::map<StringTable::Handle, Value> values;
 
@@ -68,12 +81,33 @@ class SharedContext {
 public:
     explicit SharedContext(const bite::Logger& logger) : logger(logger) {}
 
-    StringTable::Handle intern(const std::string& string) {
+    StringTable::Handle intern(const std::string_view string) {
         return string_table.intern(string);
     }
 
-    Module* get_module(StringTable::Handle name);
-    FileModule* compile(const std::string& file);
+    // need_declarations forces recompilation of modules without syntax tree
+    Module* get_module(StringTable::Handle name, bool need_declarations = false);
+    // Function bodies are compiled on their first call (see compile_lazy), but parsed and analyzed up front, so the
+    // syntax tree of a module stays alive until release_syntax_trees. Modules written to the bytecode cache have
+    // every function compiled eagerly, with cache enabled nothing is deferred.
+    FileModule* compile(const std::string& file, bool use_cache = true);
+    // false when function body can't be encoded, errors are logged
+    bool compile_lazy(Function* function);
+    // recompiles file modules which source changed and modules importing changed declarations
+    // returns names of recompiled modules
+    std::vector<StringTable::Handle> recompile_changed();
+    // compiles every function which was not called yet and frees syntax trees and sources of all file modules,
+    // declarations are recovered from source if a module is imported again later
+    // returns false and frees nothing when some function can't be compiled
+    bool release_syntax_trees();
+    // compiled modules are stored with all functions compiled, which cancels lazy compilation of function bodies
+    void enable_bytecode_cache(std::filesystem::path directory);
+    bool link_image(const std::string& file, const std::filesystem::path& output);
+    // generates C++ source embedding linked image of file, see BytecodeImage::embed
+    bool embed_image(const std::string& file, const std::filesystem::path& output);
+    FileModule* load_image(const std::filesystem::path& path);
+    // data must outlive context, meant for images embedded in host binary
+    FileModule* load_image(std::span<const unsigned char> data);
     void execute(FileModule& module);
     void add_module(const StringTable::Handle name, std::unique_ptr<ForeignModule> module);
     std::variant<std::vector<std::pair<StringTable::Handle, Value>>, std::vector<std::pair<StringTable::Handle,
@@ -86,12 +120,42 @@ public:
 
     bite::Logger logger;
     bite::DiagnosticManager diagnostics;
+    FileTable files;
+    SourceCache sources;
     GarbageCollector gc;
     std::deque<VM> running_vms;
 
 private:
-    // need to store them for lifetime reasons
-    std::deque<Ast> ast_storage;
+    // result of parsing a file before its analysis
+    struct ParsedFile {
+        Ast ast;
+        bite::DiagnosticManager diagnostics;
+        bool has_errors = false;
+        // parsed text when it was read outside of source cache, moved into the cache once parsing is done
+        std::unique_ptr<SourceFile> source;
+    };
+
+    // source is null when file can't be read
+    ParsedFile parse_file(const std::string& file, const SourceFile* source);
+    void parse_imports(const Ast& ast);
+    FileModule* load_from_cache(const std::string& file, std::uint64_t source_hash);
+    // false when some function can't be compiled, it stays lazy and other functions are still compiled
+    bool compile_lazy_recursive(Function* function);
+    std::optional<std::vector<BytecodeImage::Module>> compile_image_modules(const std::string& file);
+    FileModule* register_image(BytecodeImage& image);
+    std::vector<BytecodeCache::Dependency> collect_cache_dependencies(const std::vector<StringTable::Handle>& imports);
+    std::uint64_t compute_imports_fingerprint(const std::vector<StringTable::Handle>& imports);
+
+    std::optional<BytecodeCache> bytecode_cache;
+    std::vector<bite::mapped_file> mapped_images;
+    // file modules imported by each module currently being compiled
+    std::vector<std::vector<StringTable::Handle>> compiling_dependencies;
+    // imported files parsed ahead of time, consumed when the file is compiled
+    bite::unordered_dense::map<StringTable::Handle, ParsedFile> parsed_files;
+    // trees of replaced module versions, functions of other modules compiled against them may still be lazy
+    std::vector<std::unique_ptr<Ast>> retired_syntax_trees;
+    // trees of replaced module versions which functions failed to compile, those stay lazy so trees are never freed
+    std::vector<std::unique_ptr<Ast>> pinned_syntax_trees;
     StringTable string_table;
     bite::unordered_dense::segmented_map<StringTable::Handle, std::unique_ptr<Module>> modules;
 };
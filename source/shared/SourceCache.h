@@ -0,0 +1,118 @@
+#ifndef SOURCECACHE_H
+#define SOURCECACHE_H
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "StringTable.h"
+#include "../base/debug.h"
+#include "../base/scan.h"
+#include "../base/unordered_dense.h"
+
+/**
+ * Contents of a source file together with offsets of its line starts,
+ * so offsets are resolved to lines with binary search instead of rescanning the file.
+ */
+class SourceFile {
+public:
+    struct Location {
+        std::int64_t line; // starting from 1
+        std::int64_t column; // in bytes from start of the line
+    };
+
+    // null when file can't be read
+    static std::unique_ptr<SourceFile> read(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            return nullptr;
+        }
+        return std::make_unique<SourceFile>(std::string(std::istreambuf_iterator<char>(file), {}));
+    }
+
+    explicit SourceFile(std::string text) : m_text(std::move(text)) {
+        line_starts.push_back(0);
+        for (std::size_t position = bite::scan::find_line_end(m_text, 0); position < m_text.size();
+             position = bite::scan::find_line_end(m_text, position + 1)) {
+            line_starts.push_back(position + 1);
+        }
+    }
+
+    [[nodiscard]] std::string_view text() const {
+        return m_text;
+    }
+
+    [[nodiscard]] std::int64_t line_count() const {
+        return static_cast<std::int64_t>(line_starts.size());
+    }
+
+    // offsets outside of the file are clamped to it
+    [[nodiscard]] Location location(std::int64_t offset) const {
+        offset = std::clamp<std::int64_t>(offset, 0, static_cast<std::int64_t>(m_text.size()));
+        // first line always starts at or before offset
+        auto next_line = std::ranges::upper_bound(line_starts, static_cast<std::size_t>(offset));
+        return {
+                .line = std::distance(line_starts.begin(), next_line),
+                .column = offset - static_cast<std::int64_t>(*std::prev(next_line))
+            };
+    }
+
+    // without line terminator
+    [[nodiscard]] std::string_view line(std::int64_t line_number) const {
+        BITE_ASSERT(1 <= line_number && line_number <= line_count());
+        std::size_t start = line_starts[line_number - 1];
+        std::size_t end = line_number < line_count() ? line_starts[line_number] - 1 : m_text.size();
+        return text().substr(start, end - start);
+    }
+
+private:
+    std::string m_text;
+    std::vector<std::size_t> line_starts;
+};
+
+/**
+ * Source files read by the compiler, shared with diagnostics so files are read and indexed only once.
+ * Not synchronized, only used from the thread driving compilation.
+ */
+class SourceCache {
+public:
+    // reads file on first use, null when it can't be read
+    const SourceFile* get(StringTable::Handle path) {
+        if (auto it = files.find(path); it != files.end()) {
+            return it->second.get();
+        }
+        auto source = SourceFile::read(*path);
+        if (!source) {
+            return nullptr;
+        }
+        return (files[path] = std::move(source)).get();
+    }
+
+    // contents which differ from the file on disk, f.e. unsaved editor buffer, invalidates previously returned pointer
+    void update(StringTable::Handle path, std::string text) {
+        update(path, std::make_unique<SourceFile>(std::move(text)));
+    }
+
+    // file read elsewhere (f.e. by a thread parsing it), invalidates previously returned pointer
+    void update(StringTable::Handle path, std::unique_ptr<SourceFile> source) {
+        files[path] = std::move(source);
+    }
+
+    // file will be read again on next use, invalidates previously returned pointer
+    void invalidate(StringTable::Handle path) {
+        files.erase(path);
+    }
+
+    void clear() {
+        files.clear();
+    }
+
+private:
+    bite::unordered_dense::map<StringTable::Handle, std::unique_ptr<SourceFile>> files;
+};
+
+#endif //SOURCECACHE_H
@@ -1,20 +1,173 @@
 #ifndef STRINGTABLE_H
 #define STRINGTABLE_H
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "../base/arena.h"
+#include "../base/debug.h"
+#include "../base/hash.h"
 #include "../base/unordered_dense.h"
 
+/**
+ * Interns strings into entries placed in an arena, each entry caches its hash and gets a dense 32-bit id,
+ * so tables keyed by interned strings can be indexed by id or hashed without touching string contents.
+ */
 class StringTable {
+    struct Entry {
+        std::uint64_t hash;
+        std::uint32_t id;
+        std::string string;
+    };
+
 public:
-    using Handle = std::string const*;
+    using Id = std::uint32_t;
+
+    // stable for the lifetime of the table, dereferences to the interned string
+    class Handle {
+    public:
+        Handle() = default;
+
+        // ReSharper disable once CppNonExplicitConvertingConstructor
+        Handle(std::nullptr_t) {}
+
+        const std::string& operator*() const {
+            return entry->string;
+        }
+
+        const std::string* operator->() const {
+            return &entry->string;
+        }
+
+        explicit operator bool() const {
+            return entry != nullptr;
+        }
+
+        // ids are assigned in order of interning starting from 0, use as index into dense tables
+        [[nodiscard]] Id id() const {
+            return entry->id;
+        }
+
+        [[nodiscard]] std::uint64_t hash() const {
+            return entry->hash;
+        }
+
+        bool operator==(const Handle& other) const = default;
+        std::strong_ordering operator<=>(const Handle& other) const = default;
+
+    private:
+        friend StringTable;
+
+        explicit Handle(const Entry* entry) : entry(entry) {}
+
+        const Entry* entry = nullptr;
+    };
+
+    StringTable() = default;
+
+    StringTable(const StringTable&) = delete;
+    StringTable& operator=(const StringTable&) = delete;
+
+    ~StringTable() {
+        for (const auto* entry : entries) {
+            entry->~Entry();
+        }
+    }
 
-    Handle intern(const std::string& string) {
-        // mess
-        return &*strings.insert(string).first;
+    // Safe to call from multiple threads. Lookups of already interned strings only take shared lock,
+    // string is hashed once and copied only when it is not interned yet.
+    Handle intern(const std::string_view string) {
+        const std::uint64_t hash = bite::rapidhash::hash(string.data(), string.size());
+        const Key key { .hash = hash, .string = string };
+        {
+            std::shared_lock lock(mutex);
+            if (auto it = index.find(key); it != index.end()) {
+                return Handle(*it);
+            }
+        }
+        std::unique_lock lock(mutex);
+        // could have been interned by another thread in meantime
+        if (auto it = index.find(key); it != index.end()) {
+            return Handle(*it);
+        }
+        BITE_ASSERT(entries.size() < UINT32_MAX);
+        auto* entry = new(arena.allocate(sizeof(Entry), alignof(Entry))) Entry {
+                .hash = hash,
+                .id = static_cast<Id>(entries.size()),
+                .string = std::string(string)
+            };
+        entries.push_back(entry);
+        index.insert(entry);
+        return Handle(entry);
+    }
+
+    [[nodiscard]] Handle at(const Id id) const {
+        std::shared_lock lock(mutex);
+        BITE_ASSERT(id < entries.size());
+        return Handle(entries[id]);
+    }
+
+    // upper bound of ids handed out so far, dense tables indexed by id should have this size
+    [[nodiscard]] std::size_t size() const {
+        std::shared_lock lock(mutex);
+        return entries.size();
     }
 
 private:
-    bite::unordered_dense::segmented_set<std::string> strings;
+    // lookup key, hash is computed once and reused for probing
+    struct Key {
+        std::uint64_t hash;
+        std::string_view string;
+    };
+
+    struct EntryHash {
+        using is_transparent = void;
+        using is_avalanching = void;
+
+        std::uint64_t operator()(const Entry* entry) const noexcept {
+            return entry->hash;
+        }
+
+        std::uint64_t operator()(const Key& key) const noexcept {
+            return key.hash;
+        }
+    };
+
+    struct EntryEqual {
+        using is_transparent = void;
+
+        bool operator()(const Entry* a, const Entry* b) const noexcept {
+            return a == b;
+        }
+
+        bool operator()(const Key& key, const Entry* entry) const noexcept {
+            return key.hash == entry->hash && key.string == entry->string;
+        }
+
+        bool operator()(const Entry* entry, const Key& key) const noexcept {
+            return (*this)(key, entry);
+        }
+    };
+
+    mutable std::shared_mutex mutex;
+    bite::Arena arena;
+    std::vector<const Entry*> entries; // indexed by id
+    bite::unordered_dense::set<const Entry*, EntryHash, EntryEqual> index;
+};
+
+// interned strings are compared by identity so cached hash is enough
+template <>
+struct bite::hash<StringTable::Handle> {
+    using is_avalanching = void;
+
+    std::uint64_t operator()(const StringTable::Handle& handle) const noexcept {
+        return handle ? handle.hash() : 0;
+    }
 };
 
 #endif //STRINGTABLE_H
@@ -0,0 +1,195 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "check.h"
+#include "../../source/shared/BytecodeCache.h"
+#include "../../source/shared/BytecodeFormat.h"
+#include "../../source/shared/SharedContext.h"
+
+// Cache entries are reused only while source, imported modules and format version are unchanged.
+
+namespace {
+    Function* make_function() {
+        auto* function = new Function("main", 0, 0);
+        function->add_constant(Value(bite_int { 42 }));
+        function->add_constant(Value(std::string("answer")));
+        function->get_program().write(OpCode::CONSTANT);
+        function->get_program().write(0);
+        function->get_program().write(OpCode::RETURN);
+        function->set_max_stack(1);
+        return function;
+    }
+
+    std::filesystem::path only_entry(const std::filesystem::path& directory) {
+        std::filesystem::path entry;
+        for (const auto& file : std::filesystem::directory_iterator(directory)) {
+            if (file.path().extension() == ".bitec") {
+                entry = file.path();
+            }
+        }
+        return entry;
+    }
+
+    std::string read(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        return { std::istreambuf_iterator<char>(file), {} };
+    }
+
+    void overwrite(const std::filesystem::path& path, const std::string& contents) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    }
+
+    void delete_entry(const BytecodeCache::Entry& entry) {
+        for (auto* function : entry.functions) {
+            delete function;
+        }
+    }
+
+    void test_hit() {
+        check::TemporaryDirectory directory;
+        BytecodeCache cache(directory.path() / "cache");
+        std::string source = directory.write("main.bite", "let x = 42;");
+        auto* function = make_function();
+        CHECK(cache.store(source, 1, function, {}));
+
+        auto entry = cache.load(source, 1);
+        CHECK(entry.has_value());
+        if (entry) {
+            CHECK(entry->main->get_program().size() == function->get_program().size());
+            CHECK(entry->main->get_constants().size() == 2);
+            CHECK(entry->main->get_constant(0).get<bite_int>() == 42);
+            CHECK(entry->main->get_constant(1).get<std::string>() == "answer");
+            CHECK(entry->main->get_max_stack() == 1);
+            delete_entry(*entry);
+        }
+        // same path with different contents
+        CHECK(!cache.load(source, 2).has_value());
+        delete function;
+    }
+
+    void test_dependency_changed() {
+        check::TemporaryDirectory directory;
+        BytecodeCache cache(directory.path() / "cache");
+        std::string source = directory.write("main.bite", "");
+        std::string dependency = directory.write("dependency.bite", "let value = 1;");
+        auto* function = make_function();
+        CHECK(cache.store(source, 1, function, { { dependency, *BytecodeCache::hash_file(dependency) } }));
+
+        auto entry = cache.load(source, 1);
+        CHECK(entry.has_value());
+        if (entry) {
+            CHECK(entry->dependencies.size() == 1);
+            delete_entry(*entry);
+        }
+        directory.write("dependency.bite", "let value = 2;");
+        CHECK(!cache.load(source, 1).has_value());
+        std::filesystem::remove(dependency);
+        CHECK(!cache.load(source, 1).has_value());
+        delete function;
+    }
+
+    void test_corrupted() {
+        check::TemporaryDirectory directory;
+        BytecodeCache cache(directory.path() / "cache");
+        std::string source = directory.write("main.bite", "");
+        auto* function = make_function();
+        CHECK(cache.store(source, 1, function, {}));
+        auto entry_path = only_entry(directory.path() / "cache");
+        std::string contents = read(entry_path);
+
+        // every truncation must be rejected instead of reading past the end
+        for (std::size_t size = 0; size < contents.size(); ++size) {
+            overwrite(entry_path, contents.substr(0, size));
+            CHECK(!cache.load(source, 1).has_value());
+        }
+        overwrite(entry_path, contents + "trailing");
+        CHECK(!cache.load(source, 1).has_value());
+        overwrite(entry_path, "BITX" + contents.substr(4));
+        CHECK(!cache.load(source, 1).has_value());
+
+        overwrite(entry_path, contents);
+        auto entry = cache.load(source, 1);
+        CHECK(entry.has_value());
+        if (entry) {
+            delete_entry(*entry);
+        }
+        delete function;
+    }
+
+    void test_version_mismatch() {
+        check::TemporaryDirectory directory;
+        BytecodeCache cache(directory.path() / "cache");
+        std::string source = directory.write("main.bite", "");
+        auto* function = make_function();
+        CHECK(cache.store(source, 1, function, {}));
+        auto entry_path = only_entry(directory.path() / "cache");
+        std::string contents = read(entry_path);
+
+        // version follows the magic
+        std::uint32_t version = BYTECODE_FORMAT_VERSION + 1;
+        contents.replace(4, sizeof(version), reinterpret_cast<const char*>(&version), sizeof(version));
+        overwrite(entry_path, contents);
+        CHECK(!cache.load(source, 1).has_value());
+        delete function;
+    }
+
+    // context loads entries of unchanged modules and recompiles modules which imports changed
+    void test_context() {
+        check::TemporaryDirectory directory;
+        std::string dependency = directory.write("dependency.bite", "let value = 1;");
+        std::string main = directory.write(
+            "main.bite",
+            std::format("import value from \"{}\";\nlet doubled = value * 2;\n", dependency)
+        );
+        {
+            SharedContext context { bite::Logger(std::cerr, true) };
+            context.enable_bytecode_cache(directory.path() / "cache");
+            auto* module = context.compile(main);
+            CHECK(module && !module->is_precompiled);
+        }
+        {
+            SharedContext context { bite::Logger(std::cerr, true) };
+            context.enable_bytecode_cache(directory.path() / "cache");
+            auto* module = context.compile(main);
+            CHECK(module && module->is_precompiled);
+        }
+        directory.write("dependency.bite", "let value = 2;");
+        {
+            SharedContext context { bite::Logger(std::cerr, true) };
+            context.enable_bytecode_cache(directory.path() / "cache");
+            auto* module = context.compile(main);
+            CHECK(module && !module->is_precompiled);
+        }
+    }
+
+    // function which can't be compiled would be stored without code so module is not cached at all
+    void test_broken_function_not_stored() {
+        check::TemporaryDirectory directory;
+        std::string sum = "0";
+        for (int i = 1; i < 300; ++i) {
+            sum += std::format(" + {}", i);
+        }
+        std::string main = directory.write(
+            "main.bite",
+            std::format("fun broken() {{\n    return {};\n}}\n\nlet value = 1;\n", sum)
+        );
+        SharedContext context { bite::Logger(std::cerr, true) };
+        context.enable_bytecode_cache(directory.path() / "cache");
+        CHECK(context.compile(main) != nullptr);
+        auto cache = directory.path() / "cache";
+        CHECK(!std::filesystem::exists(cache) || only_entry(cache).empty());
+    }
+} // namespace
+
+int main() {
+    test_hit();
+    test_dependency_changed();
+    test_corrupted();
+    test_version_mismatch();
+    test_context();
+    test_broken_function_not_stored();
+    return check::result();
+}
@@ -0,0 +1,105 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "../../source/shared/BytecodeFormat.h"
+#include "../../source/shared/BytecodeImage.h"
+#include "../../source/shared/SharedContext.h"
+
+// Linked image carries main module with all of its imports and runs without their sources.
+
+namespace {
+    std::string read(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary);
+        return { std::istreambuf_iterator<char>(file), {} };
+    }
+
+    void overwrite(const std::filesystem::path& path, const std::string& contents) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    }
+
+    // links main module importing another file and removes both sources
+    std::filesystem::path link(const check::TemporaryDirectory& directory) {
+        std::string dependency = directory.write("dependency.bite", "let value = 21;\n");
+        std::string main = directory.write(
+            "main.bite",
+            std::format("import value from \"{}\";\nlet answer = value * 2;\n", dependency)
+        );
+        auto image = directory.path() / "main.biti";
+        SharedContext context { bite::Logger(std::cerr, true) };
+        CHECK(context.link_image(main, image));
+        CHECK(BytecodeImage::is_image(image));
+        CHECK(!BytecodeImage::is_image(main));
+        std::filesystem::remove(dependency);
+        std::filesystem::remove(main);
+        return image;
+    }
+
+    void check_answer(SharedContext& context, FileModule* module) {
+        CHECK(module != nullptr);
+        if (!module) {
+            return;
+        }
+        CHECK(module->is_precompiled);
+        context.execute(*module);
+        auto answer = module->values.find(context.intern("answer"));
+        CHECK(answer != module->values.end() && answer->second.get<bite_int>() == 42);
+    }
+
+    void test_mapped_round_trip() {
+        check::TemporaryDirectory directory;
+        auto image = link(directory);
+        auto loaded = BytecodeImage::load(image);
+        CHECK(loaded.has_value());
+        if (loaded) {
+            CHECK(loaded->modules.size() == 2);
+            CHECK(loaded->file.has_value());
+            for (auto* function : loaded->functions) {
+                delete function;
+            }
+        }
+
+        SharedContext context { bite::Logger(std::cerr, true) };
+        check_answer(context, context.load_image(image));
+    }
+
+    void test_memory_round_trip() {
+        check::TemporaryDirectory directory;
+        auto image = link(directory);
+        std::string contents = read(image);
+        // code is executed in place so data has to outlive context
+        std::vector<unsigned char> data(contents.begin(), contents.end());
+        SharedContext context { bite::Logger(std::cerr, true) };
+        check_answer(context, context.load_image(std::span<const unsigned char>(data)));
+    }
+
+    void test_rejected() {
+        check::TemporaryDirectory directory;
+        auto image = link(directory);
+        std::string contents = read(image);
+
+        for (std::size_t size = 0; size < contents.size(); size += 7) {
+            overwrite(image, contents.substr(0, size));
+            CHECK(!BytecodeImage::load(image).has_value());
+        }
+        // version follows the magic
+        std::string mismatched = contents;
+        std::uint32_t version = BYTECODE_FORMAT_VERSION + 1;
+        mismatched.replace(4, sizeof(version), reinterpret_cast<const char*>(&version), sizeof(version));
+        overwrite(image, mismatched);
+        CHECK(!BytecodeImage::load(image).has_value());
+        SharedContext context { bite::Logger(std::cerr, true) };
+        CHECK(context.load_image(image) == nullptr);
+    }
+} // namespace
+
+int main() {
+    test_mapped_round_trip();
+    test_memory_round_trip();
+    test_rejected();
+    return check::result();
+}
@@ -0,0 +1,67 @@
+#ifndef CHECK_H
+#define CHECK_H
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+
+// Minimal assertions for tests of C++ components. Every test file is a separate executable registered in ctest,
+// it keeps running after a failed check and its exit code reports whether all checks passed.
+
+namespace check {
+    inline int failures = 0;
+
+    inline void report(const bool passed, const char* expression, const char* file, const int line) {
+        if (!passed) {
+            std::cerr << file << ':' << line << ": check failed: " << expression << '\n';
+            ++failures;
+        }
+    }
+
+    inline int result() {
+        if (failures != 0) {
+            std::cerr << failures << " checks failed\n";
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+    // unique directory for files of one test, removed with everything inside at the end of the test
+    class TemporaryDirectory {
+    public:
+        TemporaryDirectory() : directory(
+            std::filesystem::temp_directory_path() / std::format("bite_test_{:08x}", std::random_device {}())
+        ) {
+            std::filesystem::create_directories(directory);
+        }
+
+        TemporaryDirectory(const TemporaryDirectory&) = delete;
+        TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+        ~TemporaryDirectory() {
+            std::error_code error;
+            std::filesystem::remove_all(directory, error);
+        }
+
+        [[nodiscard]] const std::filesystem::path& path() const {
+            return directory;
+        }
+
+        // returns absolute path of written file as string so it can be used as module name
+        std::string write(const std::string& name, const std::string_view contents) const {
+            auto file_path = directory / name;
+            std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+            file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+            return file_path.string();
+        }
+
+    private:
+        std::filesystem::path directory;
+    };
+} // namespace check
+
+#define CHECK(expression) check::report(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
+
+#endif //CHECK_H
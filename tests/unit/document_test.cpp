@@ -0,0 +1,127 @@
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "check.h"
+#include "../../source/shared/Document.h"
+#include "../../source/shared/SharedContext.h"
+
+// Edits within a top-level function reparse only that function, any other edit falls back to reparsing everything.
+
+namespace {
+    constexpr std::string_view SOURCE =
+        "fun a() {\n    return 1;\n}\n\nfun b() {\n    return missing;\n}\n\nlet x = a();\n";
+
+    // replaces first occurrence of text
+    void replace(Document& document, const std::string_view text, const std::string_view replacement) {
+        std::size_t start = document.text().find(text);
+        BITE_ASSERT(start != std::string::npos);
+        document.edit(start, start + text.size(), replacement);
+    }
+
+    // text which hint of the only diagnostic points at
+    std::string hinted_text(const Document& document) {
+        auto diagnostics = document.diagnostics();
+        if (diagnostics.size() != 1 || diagnostics.front().inline_hints.empty()) {
+            return {};
+        }
+        const auto& location = diagnostics.front().inline_hints.front().location;
+        return document.text().substr(location.start_offset, location.end_offset - location.start_offset);
+    }
+
+    void test_spans_shifted() {
+        SharedContext context { bite::Logger(std::cerr, true) };
+        Document document(&context, "document.bite", std::string(SOURCE));
+        CHECK(hinted_text(document) == "missing");
+
+        replace(document, "return 1;", "return 1 + 2 + 3;");
+        CHECK(document.was_incremental());
+        // diagnostic of b was reused and moved with the text after the edit
+        CHECK(hinted_text(document) == "missing");
+        replace(document, "return 1 + 2 + 3;", "return 1;");
+        CHECK(document.was_incremental());
+        CHECK(hinted_text(document) == "missing");
+        CHECK(document.ast().stmts.size() == 3);
+    }
+
+    void test_diagnostics_reused() {
+        SharedContext context { bite::Logger(std::cerr, true) };
+        Document document(&context, "document.bite", std::string(SOURCE));
+        CHECK(document.diagnostics().size() == 1);
+
+        // only diagnostics of the edited function are replaced
+        replace(document, "return 1;", "return other;");
+        CHECK(document.was_incremental());
+        CHECK(document.diagnostics().size() == 2);
+        replace(document, "return other;", "return 1;");
+        CHECK(document.was_incremental());
+        CHECK(document.diagnostics().size() == 1);
+        replace(document, "return missing;", "return 2;");
+        CHECK(document.was_incremental());
+        CHECK(document.diagnostics().empty());
+    }
+
+    void test_full_reparse() {
+        SharedContext context { bite::Logger(std::cerr, true) };
+        Document document(&context, "document.bite", std::string(SOURCE));
+
+        // edit crossing the end of a into b
+        replace(document, "1;\n}\n\nfun b() {\n    return missing;", "1;\n}\n\nfun b() {\n    return 2;");
+        CHECK(!document.was_incremental());
+        CHECK(document.ast().stmts.size() == 3);
+        CHECK(document.diagnostics().empty());
+
+        // function renamed, other statements may refer to the old name
+        replace(document, "fun a()", "fun c()");
+        CHECK(!document.was_incremental());
+        CHECK(hinted_text(document) == "a");
+
+        // not a function
+        replace(document, "let x = a();", "let x = c();");
+        CHECK(!document.was_incremental());
+        CHECK(document.diagnostics().empty());
+
+        // edit splitting function into two statements
+        replace(document, "return 2;\n", "return 2;\n}\nfun d() {\n");
+        CHECK(!document.was_incremental());
+        CHECK(document.ast().stmts.size() == 4);
+
+        // syntax error, later edits are not incremental until it is fixed
+        replace(document, "return 1;", "return 1 +;");
+        CHECK(!document.was_incremental());
+        CHECK(!document.diagnostics().empty());
+        replace(document, "return 1 +;", "return 1;");
+        CHECK(!document.was_incremental());
+        CHECK(document.diagnostics().empty());
+        replace(document, "return 1;", "return 3;");
+        CHECK(document.was_incremental());
+    }
+
+    void test_globals_updated() {
+        SharedContext context { bite::Logger(std::cerr, true) };
+        Document document(&context, "document.bite", std::string(SOURCE));
+        auto* previous = document.ast().stmts.front().get();
+
+        replace(document, "return 1;", "return 2;");
+        CHECK(document.was_incremental());
+        auto* replaced = dynamic_cast<FunctionDeclaration*>(document.ast().stmts.front().get());
+        CHECK(replaced != nullptr && replaced != previous);
+        // global binding points to the new declaration so later analysis does not see the retired one
+        auto global = document.ast().enviroment.globals.find(context.intern("a"));
+        CHECK(global != document.ast().enviroment.globals.end());
+        if (global != document.ast().enviroment.globals.end()) {
+            CHECK(global->second.declaration == static_cast<Declaration*>(replaced));
+            CHECK(global->second.is_defined);
+        }
+        // diagnostic of b was kept without reanalyzing it
+        CHECK(hinted_text(document) == "missing");
+    }
+} // namespace
+
+int main() {
+    test_spans_shifted();
+    test_diagnostics_reused();
+    test_full_reparse();
+    test_globals_updated();
+    return check::result();
+}
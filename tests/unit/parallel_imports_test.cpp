@@ -0,0 +1,92 @@
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "../../source/shared/SharedContext.h"
+
+// Imported files are parsed ahead on worker threads, batch by batch as imports of parsed files are discovered.
+
+namespace {
+    constexpr int LEAVES = 16;
+
+    // main imports many leaves which all import the same base through two levels of files
+    std::string write_tree(const check::TemporaryDirectory& directory) {
+        std::string base = directory.write("base.bite", "let base = 100;\n");
+        std::string middle = directory.write(
+            "middle.bite",
+            std::format("import base from \"{}\";\nlet middle = base;\n", base)
+        );
+        std::string main;
+        std::string sum = "0";
+        for (int i = 0; i < LEAVES; ++i) {
+            std::string leaf = directory.write(
+                std::format("leaf{}.bite", i),
+                std::format("import middle from \"{}\";\nlet value{} = middle + {};\n", middle, i, i)
+            );
+            main += std::format("import value{} from \"{}\";\n", i, leaf);
+            sum += std::format(" + value{}", i);
+        }
+        main += std::format("let total = {};\n", sum);
+        return directory.write("main.bite", main);
+    }
+
+    void test_tree() {
+        check::TemporaryDirectory directory;
+        std::string main = write_tree(directory);
+        SharedContext context { bite::Logger(std::cerr, true) };
+        auto* module = context.compile(main);
+        CHECK(module != nullptr);
+        if (!module) {
+            return;
+        }
+        context.execute(*module);
+        auto total = module->values.find(context.intern("total"));
+        constexpr bite_int EXPECTED = LEAVES * 100 + LEAVES * (LEAVES - 1) / 2;
+        CHECK(total != module->values.end() && total->second.get<bite_int>() == EXPECTED);
+        // leaves were discovered in the first batch, middle and base in the following ones
+        std::vector<std::string> imported = { "middle.bite", "base.bite" };
+        for (int i = 0; i < LEAVES; ++i) {
+            imported.push_back(std::format("leaf{}.bite", i));
+        }
+        for (const auto& file : imported) {
+            auto* imported_module = context.get_module(context.intern((directory.path() / file).string()));
+            CHECK(dynamic_cast<FileModule*>(imported_module) != nullptr);
+        }
+    }
+
+    // sources read by workers end up in source cache, later compilation and diagnostics use that text
+    void test_sources_cached() {
+        check::TemporaryDirectory directory;
+        std::string imported = directory.write("imported.bite", "let value = 1;\n");
+        std::string main = directory.write(
+            "main.bite",
+            std::format("import value from \"{}\";\nlet copy = value;\n", imported)
+        );
+        SharedContext context { bite::Logger(std::cerr, true) };
+        CHECK(context.compile(main) != nullptr);
+        directory.write("imported.bite", "let value = 2;\n");
+        const SourceFile* source = context.sources.get(context.intern(imported));
+        CHECK(source != nullptr && source->text() == "let value = 1;\n");
+    }
+
+    void test_broken_import() {
+        check::TemporaryDirectory directory;
+        std::string valid = directory.write("valid.bite", "let valid = 1;\n");
+        std::string broken = directory.write("broken.bite", "let = ;\n");
+        std::string main = directory.write(
+            "main.bite",
+            std::format("import valid from \"{}\";\nimport broken from \"{}\";\n", valid, broken)
+        );
+        SharedContext context { bite::Logger(std::cerr, true) };
+        CHECK(context.compile(main) == nullptr);
+    }
+} // namespace
+
+int main() {
+    test_tree();
+    test_sources_cached();
+    test_broken_import();
+    return check::result();
+}
@@ -0,0 +1,111 @@
+#include <format>
+#include <iostream>
+#include <string>
+
+#include "check.h"
+#include "../../source/shared/SharedContext.h"
+
+// Released modules keep running from bytecode and recover their declarations from source when imported again.
+
+namespace {
+    bool is_fully_compiled(Function* function) {
+        if (!function->is_compiled()) {
+            return false;
+        }
+        for (const auto& constant : function->get_constants()) {
+            if (auto object = constant.as<Object*>()) {
+                if (auto* nested = dynamic_cast<Function*>(*object); nested && !is_fully_compiled(nested)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    FileModule* file_module(SharedContext& context, const std::string& path) {
+        return dynamic_cast<FileModule*>(context.get_module(context.intern(path)));
+    }
+
+    bite_int global(SharedContext& context, FileModule& module, const std::string& name) {
+        auto value = module.values.find(context.intern(name));
+        return value != module.values.end() && value->second.is<bite_int>() ? value->second.get<bite_int>() : -1;
+    }
+
+    void test_import_after_release() {
+        check::TemporaryDirectory directory;
+        std::string library = directory.write(
+            "library.bite",
+            "fun twice(x) {\n    return x * 2;\n}\n\nfun never_called() {\n    return 0;\n}\n\nlet value = 21;\n"
+        );
+        std::string first = directory.write(
+            "first.bite",
+            std::format("import twice from \"{}\";\nlet first = twice(1);\n", library)
+        );
+        std::string second = directory.write(
+            "second.bite",
+            std::format(
+                "import twice from \"{0}\";\nimport value from \"{0}\";\nlet second = twice(value);\n",
+                library
+            )
+        );
+
+        SharedContext context { bite::Logger(std::cerr, true) };
+        auto* first_module = context.compile(first);
+        CHECK(first_module != nullptr);
+        if (!first_module) {
+            return;
+        }
+        context.execute(*first_module);
+        CHECK(global(context, *first_module, "first") == 2);
+
+        CHECK(context.release_syntax_trees());
+        auto* released = file_module(context, library);
+        CHECK(released != nullptr && released->ast == nullptr && released->declarations.empty());
+        CHECK(first_module->ast == nullptr);
+        // functions which were never called are compiled before their declarations are freed
+        CHECK(released != nullptr && is_fully_compiled(released->function));
+
+        auto* second_module = context.compile(second);
+        CHECK(second_module != nullptr);
+        if (!second_module) {
+            return;
+        }
+        // library was recompiled from source to recover declarations, its values survived
+        auto* recovered = file_module(context, library);
+        CHECK(recovered != nullptr && recovered->ast != nullptr && !recovered->declarations.empty());
+        CHECK(recovered != nullptr && recovered->m_was_executed && global(context, *recovered, "value") == 21);
+        context.execute(*second_module);
+        CHECK(global(context, *second_module, "second") == 42);
+    }
+
+    // body with more constants than single byte operands address is never compiled, its tree has to stay
+    void test_release_with_broken_function() {
+        check::TemporaryDirectory directory;
+        std::string sum = "0";
+        for (int i = 1; i < 300; ++i) {
+            sum += std::format(" + {}", i);
+        }
+        std::string main = directory.write(
+            "main.bite",
+            std::format("fun broken() {{\n    return {};\n}}\n\nlet value = 1;\n", sum)
+        );
+
+        SharedContext context { bite::Logger(std::cerr, true) };
+        auto* module = context.compile(main);
+        CHECK(module != nullptr);
+        if (!module) {
+            return;
+        }
+        context.execute(*module);
+        CHECK(global(context, *module, "value") == 1);
+        CHECK(!context.release_syntax_trees());
+        CHECK(module->ast != nullptr && !module->declarations.empty());
+        CHECK(!is_fully_compiled(module->function));
+    }
+} // namespace
+
+int main() {
+    test_import_after_release();
+    test_release_with_broken_function();
+    return check::result();
+}